@@ -226,6 +226,16 @@ void Dialog::onInit() {
 		wndLabel_.show();
 	};
 
+	onThinkStats = [&](const std::vector<genmove_stats>& dist) {
+
+		// follow the engine's current best move while it thinks
+		if (dist.empty() || dist.front().move < 0)
+			return;
+
+		wndLabel_.setPos(dist.front().move);
+		wndLabel_.show();
+	};
+
 	onThinkPass = [&]() {
 		MessageBox(NULL, _T("PASS"), TEXT("spy"), MB_ICONINFORMATION);
 	};
@@ -15,6 +15,8 @@ public:
     function<void(const string& line)> onInput;
     function<void(const string& line)> onOutput;
     function<void(const string& line)> onStderr;
+    // lz-analyze "info move ..." lines
+    function<void(const string& line)> onAnalysis;
     function<void()> onReset;
 
     function<void(bool,int)> onPlayChange;
@@ -120,6 +122,9 @@ public:
     bool alive();
     bool isReady();
     bool support(const string& cmd);
+    // lz-analyze lines of an external engine would be mixed into the
+    // GTP responses on stdout, which the response parser can't split.
+    bool streams_analysis() const { return false; }
     string version() const;
 
     void send_command(const string& cmd, function<void(bool, const string&)> handler=nullptr);
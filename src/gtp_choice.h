@@ -8,6 +8,7 @@ public:
     function<void(const string& line)> onInput;
     function<void(const string& line)> onOutput;
     function<void(const string& line)> onStderr;
+    function<void(const string& line)> onAnalysis;
     function<void()> onReset;
     function<void(bool,int)> onPlayChange;
 
@@ -20,6 +21,7 @@ public:
         switch_ = 0;
         gtp_blt.onInput = onInput;
         gtp_blt.onOutput = onOutput;
+        gtp_blt.onAnalysis = onAnalysis;
         gtp_blt.onReset = onReset;
         gtp_blt.onPlayChange = onPlayChange;
         if (onStderr) gtp_blt.onStderr = onStderr;
@@ -32,6 +34,7 @@ public:
         switch_ = 1;
         gtp_proc.onInput = onInput;
         gtp_proc.onOutput = onOutput;
+        gtp_proc.onAnalysis = onAnalysis;
         gtp_proc.onReset = onReset;
         gtp_proc.onPlayChange = onPlayChange;
         if (onStderr) gtp_proc.onStderr = onStderr;
@@ -60,6 +63,10 @@ public:
         return switch_ == 0 ? gtp_blt.support(cmd) : gtp_proc.support(cmd);
     }
 
+    bool streams_analysis() const {
+        return switch_ == 0 ? gtp_blt.streams_analysis() : gtp_proc.streams_analysis();
+    }
+
     string version() const;
 
     void send_command(const string& cmd, function<void(bool, const string&)> handler=nullptr) {
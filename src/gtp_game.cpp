@@ -21,6 +21,8 @@ GameAdvisor<TGTP>::GameAdvisor() {
         to_moves_.clear();
         next_side_ = true;
         resetted_ = true;
+        // a restarted or newly selected engine has to be asked again
+        analysis_on_ = false;
         execute_next_move();
     };
 
@@ -28,6 +30,10 @@ GameAdvisor<TGTP>::GameAdvisor() {
 
         processStderr(line);
     };
+
+    TGTP::onAnalysis = [this](const string& line) {
+        events_.push({"analysis", line});
+    };
 }
 
 
@@ -168,7 +174,16 @@ void GameAdvisor<TGTP>::do_think(bool black_move) {
         
     events_.push({"think", black_move ? "b" : "w"});
 
-    stats_.clear();
+    if (!TGTP::streams_analysis())
+        analysis_on_ = false;
+    else if (!analysis_on_ && TGTP::support("lz-analyze")) {
+        // stream the search stats at 10 Hz instead of scraping stderr
+        TGTP::send_command("lz-analyze 10");
+        analysis_on_ = true;
+    }
+
+    if (!analysis_on_)
+        stats_.clear();
 
     TGTP::send_command(black_move ? "genmove b" : "genmove w", [black_move, this](bool success, const string& rsp) {
 
@@ -231,7 +246,8 @@ void GameAdvisor<TGTP>::processStderr(const string& output) {
 template<class TGTP>
 void GameAdvisor<TGTP>::processStderrOneLine(const string& line) {
 
-    parseLeelaDumpStatsLine(line);
+    if (!analysis_on_)
+        parseLeelaDumpStatsLine(line);
 }
 
 template<class TGTP>
@@ -307,6 +323,49 @@ bool GameAdvisor<TGTP>::parseLeelaDumpStatsLine(const string& line) {
     return true;                          
 }
 
+template<class TGTP>
+bool GameAdvisor<TGTP>::parseAnalysisLine(const string& line) {
+
+    // info move D4 visits 120 winrate 4833 prior 869 order 0 pv D4 Q16 info move ...
+    // winrate and prior are in 1/10000
+
+    std::vector<genmove_stats> stats;
+    std::istringstream ss(line);
+    string key;
+    while (ss >> key) {
+        if (key == "info") {
+            stats.push_back({TGTP::invalid_move, 0, 0.0f, 0.0f});
+            continue;
+        }
+        if (stats.empty())
+            return false;
+
+        auto& s = stats.back();
+        string value;
+        if (key == "move" && ss >> value) {
+            s.move = TGTP::text_to_move(value);
+        } else if (key == "visits" && ss >> value) {
+            s.visits = stoi(value);
+        } else if (key == "winrate" && ss >> value) {
+            s.probs = stoi(value) / 10000.0f;
+        } else if (key == "prior" && ss >> value) {
+            s.score = stoi(value) / 10000.0f;
+        }
+        // order and the pv moves are skipped
+    }
+
+    if (stats.empty())
+        return false;
+
+    for (auto& s : stats) {
+        if (s.move == TGTP::invalid_move)
+            return false;
+    }
+
+    stats_ = std::move(stats);
+    return true;
+}
+
 
 
 
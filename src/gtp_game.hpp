@@ -17,6 +17,8 @@ public:
 
     function<void()> onResetGame;
     function<void(bool,int, const std::vector<genmove_stats>&)> onThinkMove;
+    // live search stats, only from engines that stream lz-analyze output
+    function<void(const std::vector<genmove_stats>&)> onThinkStats;
     function<void()> onThinkPass;
     function<void()> onThinkResign;
     function<void()> onThinkBegin;
@@ -84,6 +86,11 @@ public:
                 if (onGtpOut)
                     onGtpOut(ev[1]);
             }
+            else if (ev[0] == "analysis") {
+                // parsed here so stats_ is only touched by this thread
+                if (parseAnalysisLine(ev[1]) && onThinkStats)
+                    onThinkStats(stats_);
+            }
         }
     }
 
@@ -98,9 +105,11 @@ private:
     void processStderr(const string& output);
     void processStderrOneLine(const string& line);
     bool parseLeelaDumpStatsLine(const string& line);
+    bool parseAnalysisLine(const string& line);
 
     string buffer_;
     bool eat_stderr{false};
+    std::atomic<bool> analysis_on_{false};
 
 
 private:
@@ -0,0 +1,74 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "Allocations.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+
+static thread_local std::uint64_t s_allocations = 0;
+
+bool Allocations::enabled() {
+    return true;
+}
+
+std::uint64_t Allocations::thread_count() {
+    return s_allocations;
+}
+
+// The array and nothrow versions of the standard library call these.
+void* operator new(std::size_t size) {
+    s_allocations++;
+    if (size == 0) {
+        size = 1;
+    }
+    for (;;) {
+        if (auto p = std::malloc(size)) {
+            return p;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#else
+
+bool Allocations::enabled() {
+    return false;
+}
+
+std::uint64_t Allocations::thread_count() {
+    return 0;
+}
+
+#endif
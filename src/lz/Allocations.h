@@ -0,0 +1,42 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ALLOCATIONS_H_INCLUDED
+#define ALLOCATIONS_H_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+
+/*
+    Counts heap allocations, through a replacement of the global operator
+    new in Allocations.cpp. The count is per thread, so that reading it
+    costs nothing and allocating stays free of shared cache lines.
+
+    The replacement applies to the whole program, so it is only built
+    with the COUNT_ALLOCATIONS CMake option.
+*/
+namespace Allocations {
+    // Whether this build counts allocations.
+    bool enabled();
+    // Allocations made by the calling thread since it started, 0 when
+    // not enabled.
+    std::uint64_t thread_count();
+}
+
+#endif
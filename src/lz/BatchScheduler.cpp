@@ -0,0 +1,124 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "BatchScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+#include "Utils.h"
+
+BatchScheduler batch_scheduler;
+
+void BatchScheduler::initialize(int batch_size, int max_wait_us,
+                                forward_t forward) {
+    m_batch_size = std::max(1, batch_size);
+    m_max_wait = std::chrono::microseconds(std::max(0, max_wait_us));
+    m_forward = std::move(forward);
+
+    if (m_batch_size > 1) {
+        Utils::myprintf("Batching up to %zu positions, waiting at most %d us.\n",
+                        m_batch_size, max_wait_us);
+    }
+}
+
+void BatchScheduler::forward(std::vector<net_t>& input,
+                             std::vector<net_t>& output_pol,
+                             std::vector<net_t>& output_val) {
+    if (m_batch_size == 1) {
+        m_forward(input, output_pol, output_val);
+        return;
+    }
+
+    auto task = ForwardTask{&input, &output_pol, &output_val};
+    const auto deadline = std::chrono::steady_clock::now() + m_max_wait;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queue.push_back(&task);
+
+    while (!task.done) {
+        const auto timed_out = std::chrono::steady_clock::now() >= deadline;
+        if (m_queue.size() >= m_batch_size || (timed_out && !task.taken)) {
+            run_batch(lock);
+        } else if (timed_out) {
+            // Someone else is evaluating our position.
+            m_cv.wait(lock);
+        } else {
+            m_cv.wait_until(lock, deadline);
+        }
+    }
+}
+
+void BatchScheduler::run_batch(std::unique_lock<std::mutex>& lock) {
+    assert(!m_queue.empty());
+    const auto count = std::min(m_queue.size(), m_batch_size);
+    // Reused by the batches this thread collects, so that they don't
+    // allocate once grown to the batch size.
+    thread_local std::vector<ForwardTask*> tasks;
+    thread_local std::vector<net_t> input;
+    thread_local std::vector<net_t> output_pol;
+    thread_local std::vector<net_t> output_val;
+    tasks.assign(begin(m_queue), begin(m_queue) + count);
+    m_queue.erase(begin(m_queue), begin(m_queue) + count);
+    for (auto task : tasks) {
+        task->taken = true;
+    }
+    lock.unlock();
+
+    const auto input_size = tasks[0]->input->size();
+    const auto pol_size = tasks[0]->output_pol->size();
+    const auto val_size = tasks[0]->output_val->size();
+
+    input.resize(count * input_size);
+    output_pol.resize(count * pol_size);
+    output_val.resize(count * val_size);
+    for (auto i = size_t{0}; i < count; i++) {
+        std::copy(begin(*tasks[i]->input), end(*tasks[i]->input),
+                  begin(input) + i * input_size);
+    }
+
+    m_forward(input, output_pol, output_val);
+
+    for (auto i = size_t{0}; i < count; i++) {
+        std::copy(begin(output_pol) + i * pol_size,
+                  begin(output_pol) + (i + 1) * pol_size,
+                  begin(*tasks[i]->output_pol));
+        std::copy(begin(output_val) + i * val_size,
+                  begin(output_val) + (i + 1) * val_size,
+                  begin(*tasks[i]->output_val));
+    }
+
+    lock.lock();
+    for (auto task : tasks) {
+        task->done = true;
+    }
+    m_batches++;
+    m_positions += count;
+    m_cv.notify_all();
+}
+
+void BatchScheduler::dump_stats() {
+    if (m_batch_size == 1) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Utils::myprintf("NN batches: %d, %.1f positions per batch\n",
+                    m_batches, 1.0f * m_positions / std::max(1, m_batches));
+}
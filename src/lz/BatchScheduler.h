@@ -0,0 +1,83 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCHSCHEDULER_H_INCLUDED
+#define BATCHSCHEDULER_H_INCLUDED
+
+#include "config.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+    Collects network evaluations from the search threads and runs them
+    through the forward pass in batches. A search thread that queues a
+    position blocks (with its virtual losses still applied) until its
+    result is available. Whichever thread fills up a batch, or runs out
+    of waiting time, becomes the collector for the positions at the
+    front of the queue, so no extra threads are needed.
+*/
+class BatchScheduler {
+public:
+    using forward_t = std::function<void(std::vector<net_t>& input,
+                                         std::vector<net_t>& output_pol,
+                                         std::vector<net_t>& output_val)>;
+
+    void initialize(int batch_size, int max_wait_us, forward_t forward);
+    void forward(std::vector<net_t>& input,
+                 std::vector<net_t>& output_pol,
+                 std::vector<net_t>& output_val);
+    void dump_stats();
+
+private:
+    class ForwardTask {
+    public:
+        ForwardTask(std::vector<net_t> * in,
+                    std::vector<net_t> * pol,
+                    std::vector<net_t> * val)
+            : input(in), output_pol(pol), output_val(val) {}
+        std::vector<net_t> * input;
+        std::vector<net_t> * output_pol;
+        std::vector<net_t> * output_val;
+        bool taken{false};
+        bool done{false};
+    };
+
+    void run_batch(std::unique_lock<std::mutex>& lock);
+
+    forward_t m_forward;
+    size_t m_batch_size{1};
+    std::chrono::microseconds m_max_wait{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    // A vector rather than a deque, which would allocate and free blocks
+    // as the queue moves through it. It holds at most a few batches.
+    std::vector<ForwardTask*> m_queue;
+
+    // Statistics
+    int m_batches{0};
+    int m_positions{0};
+};
+
+extern BatchScheduler batch_scheduler;
+
+#endif
@@ -21,7 +21,6 @@
 #include <cassert>
 #include <array>
 #include <iostream>
-#include <queue>
 #include <sstream>
 #include <string>
 
@@ -74,6 +73,17 @@ std::pair<int, int> FastBoard::get_xy(int vertex) const {
     return std::make_pair(x, y);
 }
 
+int FastBoard::get_bit(int vertex) const {
+    assert(get_square(vertex) != INVAL);
+    return (vertex / m_squaresize - 1) * BOARD_SIZE
+         + (vertex % m_squaresize - 1);
+}
+
+const FastBoard::Bitboard& FastBoard::get_stones(int color) const {
+    assert(color == BLACK || color == WHITE);
+    return m_bitboards[color];
+}
+
 FastBoard::square_t FastBoard::get_square(int vertex) const {
     assert(vertex >= 0 && vertex < MAXSQ);
     assert(vertex >= 0 && vertex < m_maxsq);
@@ -86,7 +96,13 @@ void FastBoard::set_square(int vertex, FastBoard::square_t content) {
     assert(vertex >= 0 && vertex < m_maxsq);
     assert(content >= BLACK && content <= INVAL);
 
+    if (m_square[vertex] == BLACK || m_square[vertex] == WHITE) {
+        m_bitboards[m_square[vertex]][get_bit(vertex)] = false;
+    }
     m_square[vertex] = content;
+    if (content == BLACK || content == WHITE) {
+        m_bitboards[content][get_bit(vertex)] = true;
+    }
 }
 
 FastBoard::square_t FastBoard::get_square(int x, int y) const {
@@ -105,6 +121,9 @@ void FastBoard::reset_board(int size) {
     m_prisoners[BLACK] = 0;
     m_prisoners[WHITE] = 0;
     m_empty_cnt = 0;
+    m_bitboards[BLACK].reset();
+    m_bitboards[WHITE].reset();
+    m_onboard.reset();
 
     m_dirs[0] = -m_squaresize;
     m_dirs[1] = +1;
@@ -122,6 +141,7 @@ void FastBoard::reset_board(int size) {
             int vertex = get_vertex(i, j);
 
             m_square[vertex]          = EMPTY;
+            m_onboard[get_bit(vertex)] = true;
             m_empty_idx[vertex]       = m_empty_cnt;
             m_empty[m_empty_cnt++]    = vertex;
 
@@ -239,35 +259,37 @@ void FastBoard::remove_neighbour(const int vtx, const int color) {
     }
 }
 
-int FastBoard::calc_reach_color(int color) const {
-    auto reachable = 0;
-    auto bd = std::vector<bool>(m_maxsq, false);
-    auto open = std::queue<int>();
-    for (auto i = 0; i < m_boardsize; i++) {
-        for (auto j = 0; j < m_boardsize; j++) {
-            auto vertex = get_vertex(i, j);
-            if (m_square[vertex] == color) {
-                reachable++;
-                bd[vertex] = true;
-                open.push(vertex);
-            }
-        }
-    }
-    while (!open.empty()) {
-        /* colored field, spread */
-        auto vertex = open.front();
-        open.pop();
-
-        for (auto k = 0; k < 4; k++) {
-            auto neighbor = vertex + m_dirs[k];
-            if (!bd[neighbor] && m_square[neighbor] == EMPTY) {
-                reachable++;
-                bd[neighbor] = true;
-                open.push(neighbor);
-            }
+// points on the board next to any of points
+FastBoard::Bitboard FastBoard::spread(const Bitboard& points) const {
+    // Shifting by one moves the ends of the rows into the next row.
+    static const auto columns = [] {
+        auto first = Bitboard{};
+        for (auto y = 0; y < BOARD_SIZE; y++) {
+            first[y * BOARD_SIZE] = true;
         }
+        return std::array<Bitboard, 2>{~first, ~(first << (BOARD_SIZE - 1))};
+    }();
+    const auto& not_first = columns[0];
+    const auto& not_last = columns[1];
+
+    auto result = (points << BOARD_SIZE) | (points >> BOARD_SIZE);
+    result |= (points & not_last) << 1;
+    result |= (points & not_first) >> 1;
+    return result & m_onboard;
+}
+
+int FastBoard::calc_reach_color(int color) const {
+    const auto empty = m_onboard
+                     & ~(m_bitboards[BLACK] | m_bitboards[WHITE]);
+    auto reach = m_bitboards[color];
+    auto added = reach;
+    // Grow through the empty points a step at a time, every point
+    // at the same distance at once.
+    while (added.any()) {
+        added = spread(added) & empty & ~reach;
+        reach |= added;
     }
-    return reachable;
+    return int(reach.count());
 }
 
 // Needed for scoring passed out games not in MC playouts
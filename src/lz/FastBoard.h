@@ -22,7 +22,7 @@
 #include "config.h"
 
 #include <array>
-#include <queue>
+#include <bitset>
 #include <string>
 #include <utility>
 #include <vector>
@@ -69,6 +69,12 @@ public:
     using movescore_t = std::pair<int, float>;
     using scoredmoves_t = std::vector<movescore_t>;
 
+    /*
+        one bit per point, indexed by y * BOARD_SIZE + x like the
+        network input planes
+    */
+    using Bitboard = std::bitset<BOARD_SQUARES>;
+
     int get_boardsize(void) const;
     square_t get_square(int x, int y) const;
     square_t get_square(int vertex) const ;
@@ -76,6 +82,7 @@ public:
     void set_square(int x, int y, square_t content);
     void set_square(int vertex, square_t content);
     std::pair<int, int> get_xy(int vertex) const;
+    const Bitboard& get_stones(int color) const;
 
     bool is_suicide(int i, int color) const;
     int count_pliberties(const int i) const;
@@ -118,6 +125,8 @@ protected:
     std::array<unsigned short, MAXSQ>      m_empty;       /* empty squares */
     std::array<unsigned short, MAXSQ>      m_empty_idx;   /* indexes of square */
     int m_empty_cnt;                                      /* count of empties */
+    std::array<Bitboard, 2>                m_bitboards;   /* stones per color */
+    Bitboard                               m_onboard;     /* points on the board */
 
     int m_tomove;
     int m_maxsq;
@@ -126,6 +135,8 @@ protected:
     int m_squaresize;
 
     int calc_reach_color(int color) const;
+    int get_bit(int vertex) const;
+    Bitboard spread(const Bitboard& points) const;
 
     int count_neighbours(const int color, const int i) const;
     void merge_strings(const int ip, const int aip);
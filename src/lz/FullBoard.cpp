@@ -27,6 +27,19 @@
 
 using namespace Utils;
 
+PastBoard::PastBoard(const FullBoard& board)
+    : black(board.get_stones(FastBoard::BLACK)),
+      white(board.get_stones(FastBoard::WHITE)),
+      symmetry_hash(board.m_symmetry_hash),
+      to_move(board.get_to_move()) {
+}
+
+void FullBoard::toggle_symmetry_hash(int color, int vertex) {
+    for (auto s = 0; s < 8; s++) {
+        m_symmetry_hash[s] ^= Zobrist::zobrist_symmetry[s][color][vertex];
+    }
+}
+
 int FullBoard::remove_string(int i) {
     int pos = i;
     int removed = 0;
@@ -35,8 +48,10 @@ int FullBoard::remove_string(int i) {
     do {
         m_hash    ^= Zobrist::zobrist[m_square[pos]][pos];
         m_ko_hash ^= Zobrist::zobrist[m_square[pos]][pos];
+        toggle_symmetry_hash(color, pos);
 
         m_square[pos] = EMPTY;
+        m_bitboards[color][get_bit(pos)] = false;
         m_parent[pos] = MAXSQ;
 
         remove_neighbour(pos, color);
@@ -72,10 +87,14 @@ std::uint64_t FullBoard::calc_ko_hash(void) {
 std::uint64_t FullBoard::calc_hash(int komove) {
     auto res = Zobrist::zobrist_empty;
 
+    m_symmetry_hash.fill(0);
     for (int i = 0; i < m_maxsq; i++) {
         if (m_square[i] != INVAL) {
             res ^= Zobrist::zobrist[m_square[i]][i];
         }
+        if (m_square[i] == BLACK || m_square[i] == WHITE) {
+            toggle_symmetry_hash(m_square[i], i);
+        }
     }
 
     /* prisoner hashing is rule set dependent */
@@ -101,6 +120,10 @@ std::uint64_t FullBoard::get_ko_hash(void) const {
     return m_ko_hash;
 }
 
+std::uint64_t FullBoard::get_symmetry_hash(int symmetry) const {
+    return m_symmetry_hash[symmetry];
+}
+
 void FullBoard::set_to_move(int tomove) {
     if (m_tomove != tomove) {
         m_hash ^= Zobrist::zobrist_blacktomove;
@@ -116,6 +139,7 @@ int FullBoard::update_board(const int color, const int i) {
     m_ko_hash ^= Zobrist::zobrist[m_square[i]][i];
 
     m_square[i] = (square_t)color;
+    m_bitboards[color][get_bit(i)] = true;
     m_next[i] = i;
     m_parent[i] = i;
     m_libs[i] = count_pliberties(i);
@@ -123,6 +147,7 @@ int FullBoard::update_board(const int color, const int i) {
 
     m_hash ^= Zobrist::zobrist[m_square[i]][i];
     m_ko_hash ^= Zobrist::zobrist[m_square[i]][i];
+    toggle_symmetry_hash(color, i);
 
     /* update neighbor liberties (they all lose 1) */
     add_neighbour(i, color);
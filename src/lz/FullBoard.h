@@ -20,9 +20,24 @@
 #define FULLBOARD_H_INCLUDED
 
 #include "config.h"
+#include <array>
 #include <cstdint>
 #include "FastBoard.h"
 
+class FullBoard;
+
+// What the network input and the NNCache key use of a position, a small
+// part of a FullBoard, so that it is cheap to keep for earlier positions.
+struct PastBoard {
+    PastBoard() = default;
+    explicit PastBoard(const FullBoard& board);
+
+    FastBoard::Bitboard black;
+    FastBoard::Bitboard white;
+    std::array<std::uint64_t, 8> symmetry_hash;
+    int to_move;
+};
+
 class FullBoard : public FastBoard {
 public:
     int remove_string(int i);
@@ -32,6 +47,8 @@ public:
     std::uint64_t calc_ko_hash(void);
     std::uint64_t get_hash(void) const;
     std::uint64_t get_ko_hash(void) const;
+    // Hash of the stones only, as seen after the board symmetry.
+    std::uint64_t get_symmetry_hash(int symmetry) const;
     void set_to_move(int tomove);
 
     void reset_board(int size);
@@ -39,6 +56,10 @@ public:
 
     std::uint64_t m_hash;
     std::uint64_t m_ko_hash;
+    std::array<std::uint64_t, 8> m_symmetry_hash;
+
+private:
+    void toggle_symmetry_hash(int color, int vertex);
 };
 
 #endif
@@ -53,6 +53,13 @@ int cfg_num_threads;
 int cfg_max_threads;
 int cfg_max_playouts;
 int cfg_max_visits;
+int cfg_batch_size;
+int cfg_batch_wait_us;
+std::uint64_t cfg_max_tree_memory;
+bool cfg_transpositions;
+bool cfg_int8;
+bool cfg_average_symmetries;
+int cfg_analyze_interval_centis;
 TimeManagement::enabled_t cfg_timemanage;
 int cfg_lagbuffer_cs;
 int cfg_resignpct;
@@ -67,6 +74,7 @@ float cfg_puct;
 float cfg_softmax_temp;
 float cfg_fpu_reduction;
 std::string cfg_weightsfile;
+std::string cfg_nncache_file;
 std::string cfg_logfile;
 FILE* cfg_logfile_handle;
 bool cfg_quiet;
@@ -85,6 +93,13 @@ void GTP::setup_default_parameters() {
 #endif
     cfg_max_playouts = std::numeric_limits<decltype(cfg_max_playouts)>::max();
     cfg_max_visits = std::numeric_limits<decltype(cfg_max_visits)>::max();
+    cfg_batch_size = 1;
+    cfg_batch_wait_us = 1000;
+    cfg_max_tree_memory = UCTSearch::DEFAULT_MAX_TREE_MEMORY;
+    cfg_transpositions = false;
+    cfg_int8 = false;
+    cfg_average_symmetries = false;
+    cfg_analyze_interval_centis = 0;
     cfg_timemanage = TimeManagement::AUTO;
     cfg_lagbuffer_cs = 100;
 #ifdef USE_OPENCL
@@ -162,6 +177,16 @@ bool GTP::vstderr(const char *fmt, va_list ap) {
 
 
 
+void GTP::analysis_output(const std::string& line) {
+
+    if (gtp_inst && gtp_inst->onAnalysis) {
+        gtp_inst->onAnalysis(line);
+    } else {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    }
+}
+
 GTP::GTP()
 {
     gtp_inst = this;
@@ -201,6 +226,11 @@ void init_global_objects() {
 
     // Initialize network
     Network::initialize();
+
+    // Warm start from the last run, saved again on quit.
+    if (!cfg_nncache_file.empty()) {
+        NNCache::get_NNCache().load(cfg_nncache_file);
+    }
 }
 
 static const vector<string> s_commands = {
@@ -222,7 +252,14 @@ static const vector<string> s_commands = {
         "time_left",
         "fixed_handicap",
         "place_free_handicap",
-        "set_free_handicap"
+        "set_free_handicap",
+        "lz-treememory",
+        "lz-benchmark",
+        "lz-analyze",
+        "lz-int8-accuracy",
+        "lz-nnbenchmark",
+        "lz-nncache-benchmark",
+        "lz-nncache"
     };
 
 bool GTP::support(const string& cmd) {
@@ -279,6 +316,7 @@ void GTP::run() {
 
 
     bool pondering = false;
+    bool analyzing = false;
     string command;
 
     for (;;) {
@@ -321,6 +359,7 @@ void GTP::run() {
 
             stop_ponder();
             pondering = false;
+            analyzing = false;
 
             if (std::isdigit(input[0])) {
 				std::istringstream strm(input);
@@ -336,7 +375,8 @@ void GTP::run() {
 
         input_pending_ = false;
 
-        if (pondering && cfg_allow_pondering && !game->has_resigned()) {
+        if ((analyzing || (pondering && cfg_allow_pondering))
+            && !game->has_resigned()) {
             search->ponder();
         }
 
@@ -350,6 +390,9 @@ void GTP::run() {
         } else if (command == "version") {
             gtp_print(PROGRAM_VERSION);
         } else if (command == "quit") {
+            if (!cfg_nncache_file.empty()) {
+                NNCache::get_NNCache().save(cfg_nncache_file);
+            }
             gtp_print("");
             return;
         }  else if (command.find("known_command") == 0) {
@@ -647,6 +690,138 @@ void GTP::run() {
                 }
             }
 
+        } else if (command.find("lz-treememory") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int mib;
+
+            cmdstream >> tmp;   // eat lz-treememory
+            cmdstream >> mib;
+
+            if (command.find(' ') == std::string::npos) {
+                gtp_print("%d", static_cast<int>(cfg_max_tree_memory >> 20));
+            } else if (!cmdstream.fail() && mib > 0) {
+                cfg_max_tree_memory = std::uint64_t(mib) << 20;
+                gtp_print("");
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-benchmark") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int playouts = 1600;
+            int max_threads = 64;
+            int value;
+
+            cmdstream >> tmp;   // eat lz-benchmark
+            if (cmdstream >> value) {
+                playouts = value;
+                if (cmdstream >> value) {
+                    max_threads = value;
+                }
+            }
+
+            if (playouts > 0 && max_threads > 0) {
+                auto table = search->thread_scaling_benchmark(playouts,
+                                                              max_threads);
+                gtp_print("%s", table.c_str());
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-analyze") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int interval;
+
+            cmdstream >> tmp;   // eat lz-analyze
+            cmdstream >> interval;
+
+            // The interval (in centiseconds) also applies to genmove,
+            // "lz-analyze 0" turns the output off again.
+            if (!cmdstream.fail() && interval >= 0) {
+                cfg_analyze_interval_centis = interval;
+                gtp_print("");
+                // Ponder and stream until the next command arrives.
+                analyzing = interval > 0;
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-int8-accuracy") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int positions = 200;
+
+            cmdstream >> tmp;   // eat lz-int8-accuracy
+            cmdstream >> positions;
+
+            if (positions > 0) {
+                auto report = Network::int8_accuracy(positions);
+                if (report.empty()) {
+                    gtp_fail("int8 inference is off, start with --int8");
+                } else {
+                    gtp_print("%s", report.c_str());
+                }
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-nnbenchmark") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int evaluations = 1600;
+
+            cmdstream >> tmp;   // eat lz-nnbenchmark
+            cmdstream >> evaluations;
+
+            if (evaluations > 0) {
+                auto report = Network::benchmark(game.get(), evaluations);
+                gtp_print("%s", report.c_str());
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-nncache-benchmark") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp;
+            int threads = cfg_num_threads;
+
+            cmdstream >> tmp;   // eat lz-nncache-benchmark
+            cmdstream >> threads;
+
+            if (threads > 0) {
+                auto report = NNCache::benchmark(threads);
+                gtp_print("%s", report.c_str());
+            } else {
+                gtp_fail("syntax not understood");
+            }
+
+        } else if (command.find("lz-nncache ") == 0) {
+            std::istringstream cmdstream(command);
+            std::string tmp, action, filename;
+
+            cmdstream >> tmp;   // eat lz-nncache
+            cmdstream >> action >> filename;
+
+            if (cmdstream.fail() || (action != "save" && action != "load")) {
+                gtp_fail("syntax not understood");
+            } else if (action == "save") {
+                if (NNCache::get_NNCache().save(filename)) {
+                    gtp_print("");
+                } else {
+                    gtp_fail("cannot save NNCache");
+                }
+            } else {
+                auto entries = NNCache::get_NNCache().load(filename);
+                if (entries >= 0) {
+                    gtp_print("%d", entries);
+                } else {
+                    gtp_fail("cannot load NNCache");
+                }
+            }
+
         } else {
             gtp_fail("unknown command");
         }
@@ -39,6 +39,13 @@ extern int cfg_num_threads;
 extern int cfg_max_threads;
 extern int cfg_max_playouts;
 extern int cfg_max_visits;
+extern int cfg_batch_size;
+extern int cfg_batch_wait_us;
+extern std::uint64_t cfg_max_tree_memory;
+extern bool cfg_transpositions;
+extern bool cfg_int8;
+extern bool cfg_average_symmetries;
+extern int cfg_analyze_interval_centis;
 extern TimeManagement::enabled_t cfg_timemanage;
 extern int cfg_lagbuffer_cs;
 extern int cfg_resignpct;
@@ -54,6 +61,7 @@ extern float cfg_softmax_temp;
 extern float cfg_fpu_reduction;
 extern std::string cfg_logfile;
 extern std::string cfg_weightsfile;
+extern std::string cfg_nncache_file;
 extern FILE* cfg_logfile_handle;
 extern bool cfg_quiet;
 
@@ -72,6 +80,9 @@ public:
     ~GTP();
 
     static bool vstderr(const char *fmt, va_list ap);
+    // Sends an lz-analyze line to onAnalysis, or to stdout when there
+    // is no listener.
+    static void analysis_output(const std::string& line);
 
     static void setup_default_parameters();
 
@@ -85,6 +96,7 @@ public:
     }
     bool isReady() { return alive(); }
     bool support(const string& cmd);
+    bool streams_analysis() const { return true; }
     string version() const;
 
     void execute() {
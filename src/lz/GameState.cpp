@@ -23,7 +23,6 @@
 #include <cassert>
 #include <cctype>
 #include <iterator>
-#include <memory>
 #include <sstream>
 #include <string>
 
@@ -36,8 +35,7 @@
 void GameState::init_game(int size, float komi) {
     KoState::init_game(size, komi);
 
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    anchor_game_history();
 
     m_timecontrol.set_boardsize(board.get_boardsize());
     m_timecontrol.reset_clocks();
@@ -48,18 +46,29 @@ void GameState::init_game(int size, float komi) {
 void GameState::reset_game() {
     KoState::reset_game();
 
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    anchor_game_history();
 
     m_timecontrol.reset_clocks();
 
     m_resigned = FastBoard::EMPTY;
 }
 
+void GameState::replay_moves(size_t movenum) {
+    // These are settings of the game rather than of the position.
+    const auto komi = get_komi();
+    const auto handicap = get_handicap();
+    *(static_cast<KoState*>(this)) = m_anchor;
+    for (auto i = size_t{0}; i < movenum; i++) {
+        KoState::play_move(m_moves[i].color, m_moves[i].vertex);
+    }
+    set_komi(komi);
+    set_handicap(handicap);
+}
+
 bool GameState::forward_move(void) {
-    if (game_history.size() > m_movenum + 1) {
-        m_movenum++;
-        *(static_cast<KoState*>(this)) = *game_history[m_movenum];
+    if (m_moves.size() > m_movenum) {
+        const auto& move = m_moves[m_movenum];
+        KoState::play_move(move.color, move.vertex);
         return true;
     } else {
         return false;
@@ -68,12 +77,8 @@ bool GameState::forward_move(void) {
 
 bool GameState::undo_move(void) {
     if (m_movenum > 0) {
-        m_movenum--;
-
-        // this is not so nice, but it should work
-        *(static_cast<KoState*>(this)) = *game_history[m_movenum];
-
-        // This also restores hashes as they're part of state
+        // Only the moves are kept, so this replays all but the last one.
+        replay_moves(m_movenum - 1);
         return true;
     } else {
         return false;
@@ -81,8 +86,7 @@ bool GameState::undo_move(void) {
 }
 
 void GameState::rewind(void) {
-    *(static_cast<KoState*>(this)) = *game_history[0];
-    m_movenum = 0;
+    replay_moves(0);
 }
 
 void GameState::play_move(int vertex) {
@@ -90,15 +94,17 @@ void GameState::play_move(int vertex) {
 }
 
 void GameState::play_move(int color, int vertex) {
+    // cut off any leftover moves from navigating
+    m_moves.resize(m_movenum);
+    m_past_boards.resize(m_movenum + 1);
+
     if (vertex == FastBoard::RESIGN) {
         m_resigned = color;
     } else {
         KoState::play_move(color, vertex);
+        m_moves.push_back({color, vertex});
+        m_past_boards.emplace_back(board);
     }
-
-    // cut off any leftover moves from navigating
-    game_history.resize(m_movenum);
-    game_history.emplace_back(std::make_shared<KoState>(*this));
 }
 
 bool GameState::play_textmove(const std::string& color,
@@ -200,8 +206,10 @@ void GameState::adjust_time(int color, int time, int stones) {
 void GameState::anchor_game_history(void) {
     // handicap moves don't count in game history
     m_movenum = 0;
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    m_anchor = *this;
+    m_moves.clear();
+    m_past_boards.clear();
+    m_past_boards.emplace_back(board);
 }
 
 bool GameState::set_fixed_handicap(int handicap) {
@@ -333,8 +341,8 @@ void GameState::place_free_handicap(int stones) {
     set_handicap(orgstones);
 }
 
-const FullBoard& GameState::get_past_board(int moves_ago) const {
+const PastBoard& GameState::get_past_board(int moves_ago) const {
     assert(moves_ago >= 0 && (unsigned)moves_ago <= m_movenum);
-    assert(m_movenum + 1 <= game_history.size());
-    return game_history[m_movenum - moves_ago]->board;
+    assert(m_movenum + 1 <= m_past_boards.size());
+    return m_past_boards[m_movenum - moves_ago];
 }
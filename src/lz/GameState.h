@@ -19,7 +19,6 @@
 #ifndef GAMESTATE_H_INCLUDED
 #define GAMESTATE_H_INCLUDED
 
-#include <memory>
 #include <string>
 #include <vector>
 
@@ -46,7 +45,7 @@ public:
     void rewind(void); /* undo infinite */
     bool undo_move(void);
     bool forward_move(void);
-    const FullBoard& get_past_board(int moves_ago) const;
+    const PastBoard& get_past_board(int moves_ago) const;
 
     void play_move(int color, int vertex);
     void play_move(int vertex);
@@ -67,8 +66,20 @@ public:
 
 private:
     bool valid_handicap(int stones);
+    // Rebuilds the position after movenum of m_moves from m_anchor.
+    void replay_moves(size_t movenum);
 
-    std::vector<std::shared_ptr<const KoState>> game_history;
+    struct Move {
+        int color;
+        int vertex;
+    };
+    // The position the history starts from, after any handicap stones.
+    KoState m_anchor;
+    // Moves played from m_anchor, including those undone that
+    // forward_move can redo.
+    std::vector<Move> m_moves;
+    // m_anchor then the position after each of m_moves.
+    std::vector<PastBoard> m_past_boards;
     TimeControl m_timecontrol;
     int m_resigned{FastBoard::EMPTY};
 };
@@ -0,0 +1,78 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Built with AVX2 enabled, see CMakeLists.txt. Only called when
+// Int8Kernels::get_isa() found AVX2 on the CPU.
+
+#include "config.h"
+#include "Int8Kernels.h"
+
+#ifdef __AVX2__
+#include <cstring>
+#include <immintrin.h>
+
+#include "Int8Simd.h"
+
+namespace {
+
+struct Avx2Ops {
+    using vec = __m256i;
+    static constexpr auto LANES = 8;
+    static constexpr auto KBLOCK = 2;
+    static constexpr auto XBLOCK = 4;
+
+    static vec zero() {
+        return _mm256_setzero_si256();
+    }
+    static vec broadcast(const std::uint8_t* p) {
+        std::int32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return _mm256_set1_epi32(v);
+    }
+    static vec load(const std::int8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    static vec dot(vec acc, vec a, vec w) {
+        // Pairs of u8 * s8 products summed to s16, which can't saturate
+        // as the activations are at most 127, then pairs of those to s32.
+        const auto pairs = _mm256_maddubs_epi16(a, w);
+        const auto quads = _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+        return _mm256_add_epi32(acc, quads);
+    }
+    static void store(std::int32_t* p, vec v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+    }
+};
+
+}
+
+bool Int8Kernels::convolve3_avx2(const std::uint8_t* act,
+                                 const std::int8_t* weights,
+                                 int C, int K, std::int32_t* output) {
+    convolve<Avx2Ops>(act, weights, C, K, output);
+    return true;
+}
+
+#else
+
+bool Int8Kernels::convolve3_avx2(const std::uint8_t*, const std::int8_t*,
+                                 int, int, std::int32_t*) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "Int8Kernels.h"
+
+#include <cassert>
+#include <cstddef>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#include "WinogradKernels.h"
+
+using namespace Int8Kernels;
+
+static Isa detect_isa() {
+    // The Winograd detection already checked the OS support for the
+    // AVX2 and AVX-512 registers, VNNI only adds an instruction.
+    const auto vector_isa = WinogradKernels::get_isa();
+    if (vector_isa == WinogradKernels::Isa::SCALAR) {
+        return Isa::SCALAR;
+    }
+    if (vector_isa == WinogradKernels::Isa::AVX512) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if (__builtin_cpu_supports("avx512vnni")) {
+            return Isa::VNNI;
+        }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int regs[4];
+        __cpuidex(regs, 7, 0);
+        if (regs[2] & (1 << 11)) {
+            return Isa::VNNI;
+        }
+#endif
+    }
+    return Isa::AVX2;
+}
+
+Isa Int8Kernels::get_isa() {
+    static const auto isa = detect_isa();
+    return isa;
+}
+
+const char* Int8Kernels::get_isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::VNNI:
+        return "AVX-512 VNNI";
+    case Isa::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+int Int8Kernels::pad_channels(int C) {
+    return (C + 3) / 4 * 4;
+}
+
+int Int8Kernels::pad_outputs(int K) {
+    return (K + 15) / 16 * 16;
+}
+
+std::vector<std::int8_t> Int8Kernels::pack_weights(
+    const std::vector<std::int8_t>& w, int K, int C) {
+    assert(w.size() == std::size_t(K * C * 9));
+    const auto C4 = pad_channels(C) / 4;
+    const auto Kpad = pad_outputs(K);
+    // [tap][C / 4][Kpad][4]: each output lane reads 4 consecutive
+    // channels, matching the 4 activation bytes broadcast to all lanes.
+    auto packed = std::vector<std::int8_t>(9 * C4 * Kpad * 4);
+    for (auto k = 0; k < K; k++) {
+        for (auto c = 0; c < C; c++) {
+            for (auto t = 0; t < 9; t++) {
+                const auto idx = ((t * C4 + c / 4) * Kpad + k) * 4 + c % 4;
+                packed[idx] = w[(k * C + c) * 9 + t];
+            }
+        }
+    }
+    return packed;
+}
+
+static void convolve3_scalar(const std::uint8_t* act,
+                             const std::int8_t* w,
+                             const int C, const int K,
+                             std::int32_t* output) {
+    constexpr auto W = BOARD_SIZE;
+    const auto cpad = pad_channels(C);
+    const auto C4 = cpad / 4;
+    const auto Kpad = pad_outputs(K);
+    for (auto y = 0; y < W; y++) {
+        for (auto x = 0; x < W; x++) {
+            const auto out = output + (y * W + x) * Kpad;
+            for (auto k = 0; k < Kpad; k++) {
+                out[k] = 0;
+            }
+            for (auto t = 0; t < 9; t++) {
+                const auto a = act + ((y + t / 3) * PAD + x + t % 3) * cpad;
+                for (auto c4 = 0; c4 < C4; c4++) {
+                    const auto wp = w + (t * C4 + c4) * Kpad * 4;
+                    for (auto k = 0; k < Kpad; k++) {
+                        auto sum = 0;
+                        for (auto j = 0; j < 4; j++) {
+                            sum += a[4 * c4 + j] * wp[4 * k + j];
+                        }
+                        out[k] += sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Int8Kernels::convolve3(const std::uint8_t* act,
+                            const std::int8_t* weights,
+                            int C, int K, std::int32_t* output) {
+    const auto isa = get_isa();
+    if (isa == Isa::VNNI
+        && convolve3_vnni(act, weights, C, K, output)) {
+        return;
+    }
+    if (isa != Isa::SCALAR
+        && convolve3_avx2(act, weights, C, K, output)) {
+        return;
+    }
+    convolve3_scalar(act, weights, C, K, output);
+}
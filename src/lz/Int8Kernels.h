@@ -0,0 +1,69 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INT8KERNELS_H_INCLUDED
+#define INT8KERNELS_H_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+    8-bit 3x3 convolutions for the optional int8 residual tower (see
+    cfg_int8). Activations are unsigned, weights signed, and the products
+    are summed in 32 bits. Activations are limited to [0, MAX_ACTIVATION]
+    so that the pairwise 16-bit sums of the AVX2 maddubs instruction can't
+    saturate, which keeps all instruction sets bit exact to each other.
+
+    Layouts:
+        activations  [PAD * PAD][pad_channels(C)] uint8, the board with a
+                     border of one zero point on each side
+        weights      pack_weights() of [K][C][3 * 3] int8
+        output       [BOARD_SQUARES][pad_outputs(K)] int32
+*/
+namespace Int8Kernels {
+    enum class Isa {
+        SCALAR, AVX2, VNNI
+    };
+
+    constexpr auto PAD = BOARD_SIZE + 2;
+    constexpr auto MAX_ACTIVATION = 127;
+    constexpr auto MAX_WEIGHT = 127;
+
+    // Best instruction set available on this CPU, detected once.
+    Isa get_isa();
+    const char* get_isa_name(Isa isa);
+
+    // Channels are consumed 4 at a time, outputs 16 at a time.
+    int pad_channels(int C);
+    int pad_outputs(int K);
+    std::vector<std::int8_t> pack_weights(const std::vector<std::int8_t>& w,
+                                          int K, int C);
+
+    void convolve3(const std::uint8_t* act, const std::int8_t* weights,
+                   int C, int K, std::int32_t* output);
+
+    // Per instruction set versions, false when not compiled in.
+    bool convolve3_avx2(const std::uint8_t* act, const std::int8_t* weights,
+                        int C, int K, std::int32_t* output);
+    bool convolve3_vnni(const std::uint8_t* act, const std::int8_t* weights,
+                        int C, int K, std::int32_t* output);
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INT8SIMD_H_INCLUDED
+#define INT8SIMD_H_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+
+/*
+    Convolution kernel shared by the per instruction set translation units
+    (Int8Avx2.cpp, Int8Vnni.cpp), which include this file with their own
+    Ops:
+
+        vec, LANES          LANES int32 sums per vector
+        zero()
+        broadcast(p)        the 4 activation bytes at p in every lane
+        load(p)             4 * LANES weight bytes
+        dot(acc, a, w)      acc + the sum of the 4 products in each lane
+        store(p, v)
+        KBLOCK, XBLOCK      output vectors times points of a row summed
+                            together, so that each weight load and each
+                            broadcast is used several times
+
+    As with WinogradSimd.h everything is in an anonymous namespace, as it
+    is compiled with flags the rest of the program can't assume.
+*/
+namespace {
+
+constexpr auto BW = BOARD_SIZE;
+constexpr auto BPAD = BOARD_SIZE + 2;
+
+template <typename Ops, int N, int R>
+void accumulate(const std::uint8_t* act, const std::int8_t* w,
+                const int C4, const int Kpad, const int corner,
+                const int kv, std::int32_t* out) {
+    const auto cpad = 4 * C4;
+    typename Ops::vec acc[R][N];
+    for (auto r = 0; r < R; r++) {
+        for (auto b = 0; b < N; b++) {
+            acc[r][b] = Ops::zero();
+        }
+    }
+    for (auto dy = 0; dy < 3; dy++) {
+        for (auto dx = 0; dx < 3; dx++) {
+            const auto a = act + (corner + dy * BPAD + dx) * cpad;
+            const auto wt = w + ((dy * 3 + dx) * C4 * Kpad
+                                 + kv * Ops::LANES) * 4;
+            for (auto c4 = 0; c4 < C4; c4++) {
+                const auto wp = wt + c4 * Kpad * 4;
+                typename Ops::vec wv[N];
+                for (auto b = 0; b < N; b++) {
+                    wv[b] = Ops::load(wp + b * Ops::LANES * 4);
+                }
+                for (auto r = 0; r < R; r++) {
+                    const auto av = Ops::broadcast(a + r * cpad + 4 * c4);
+                    for (auto b = 0; b < N; b++) {
+                        acc[r][b] = Ops::dot(acc[r][b], av, wv[b]);
+                    }
+                }
+            }
+        }
+    }
+    for (auto r = 0; r < R; r++) {
+        for (auto b = 0; b < N; b++) {
+            Ops::store(out + r * Kpad + (kv + b) * Ops::LANES, acc[r][b]);
+        }
+    }
+}
+
+template <typename Ops, int R>
+void convolve_points(const std::uint8_t* act, const std::int8_t* w,
+                     const int C4, const int Kpad, const int corner,
+                     std::int32_t* out) {
+    const auto kvecs = Kpad / Ops::LANES;
+    auto kv = 0;
+    for (; kv + Ops::KBLOCK <= kvecs; kv += Ops::KBLOCK) {
+        accumulate<Ops, Ops::KBLOCK, R>(act, w, C4, Kpad, corner, kv, out);
+    }
+    for (; kv + 2 <= kvecs; kv += 2) {
+        accumulate<Ops, 2, R>(act, w, C4, Kpad, corner, kv, out);
+    }
+    for (; kv < kvecs; kv++) {
+        accumulate<Ops, 1, R>(act, w, C4, Kpad, corner, kv, out);
+    }
+}
+
+template <typename Ops>
+void convolve(const std::uint8_t* act, const std::int8_t* w,
+              const int C, const int K, std::int32_t* output) {
+    const auto C4 = (C + 3) / 4;
+    const auto Kpad = (K + 15) / 16 * 16;
+    for (auto y = 0; y < BW; y++) {
+        // corner is the padded point above and to the left of (x, y).
+        auto x = 0;
+        for (; x + Ops::XBLOCK <= BW; x += Ops::XBLOCK) {
+            convolve_points<Ops, Ops::XBLOCK>(act, w, C4, Kpad,
+                                              y * BPAD + x,
+                                              output + (y * BW + x) * Kpad);
+        }
+        for (; x < BW; x++) {
+            convolve_points<Ops, 1>(act, w, C4, Kpad, y * BPAD + x,
+                                    output + (y * BW + x) * Kpad);
+        }
+    }
+}
+
+}
+
+#endif
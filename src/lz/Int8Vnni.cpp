@@ -0,0 +1,75 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Built with AVX-512 VNNI enabled, see CMakeLists.txt. Only called when
+// Int8Kernels::get_isa() found VNNI on the CPU.
+
+#include "config.h"
+#include "Int8Kernels.h"
+
+// MSVC has no macro for VNNI, but provides the intrinsics with AVX-512.
+#if defined(__AVX512F__) && (defined(__AVX512VNNI__) || defined(_MSC_VER))
+#include <cstring>
+#include <immintrin.h>
+
+#include "Int8Simd.h"
+
+namespace {
+
+struct VnniOps {
+    using vec = __m512i;
+    static constexpr auto LANES = 16;
+    static constexpr auto KBLOCK = 4;
+    static constexpr auto XBLOCK = 4;
+
+    static vec zero() {
+        return _mm512_setzero_si512();
+    }
+    static vec broadcast(const std::uint8_t* p) {
+        std::int32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return _mm512_set1_epi32(v);
+    }
+    static vec load(const std::int8_t* p) {
+        return _mm512_loadu_si512(p);
+    }
+    static vec dot(vec acc, vec a, vec w) {
+        return _mm512_dpbusd_epi32(acc, a, w);
+    }
+    static void store(std::int32_t* p, vec v) {
+        _mm512_storeu_si512(p, v);
+    }
+};
+
+}
+
+bool Int8Kernels::convolve3_vnni(const std::uint8_t* act,
+                                 const std::int8_t* weights,
+                                 int C, int K, std::int32_t* output) {
+    convolve<VnniOps>(act, weights, C, K, output);
+    return true;
+}
+
+#else
+
+bool Int8Kernels::convolve3_vnni(const std::uint8_t*, const std::int8_t*,
+                                 int, int, std::int32_t*) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KOHASHSET_H_INCLUDED
+#define KOHASHSET_H_INCLUDED
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    Multiset of the ko hashes of a game, for positional superko. Open
+    addressing with linear probing; ko hashes are Zobrist keys, so their
+    low bits index the table directly. A position repeats when a pass is
+    played, so every hash has a count.
+*/
+class KoHashSet {
+public:
+    void clear() {
+        m_slots.clear();
+        m_entries = 0;
+    }
+
+    void insert(std::uint64_t hash) {
+        // Kept at most 3/4 full.
+        if (4 * (m_entries + 1) > 3 * m_slots.size()) {
+            grow();
+        }
+        auto& slot = find_slot(hash);
+        if (slot.count == 0) {
+            slot.hash = hash;
+            m_entries++;
+        }
+        slot.count++;
+    }
+
+    // Number of times hash was inserted.
+    std::uint32_t count(std::uint64_t hash) const {
+        if (m_slots.empty()) {
+            return 0;
+        }
+        return find_slot(hash).count;
+    }
+
+private:
+    struct Slot {
+        std::uint64_t hash;
+        std::uint32_t count;
+    };
+
+    // The slot holding hash, or the empty one where it would go.
+    const Slot& find_slot(std::uint64_t hash) const {
+        const auto mask = m_slots.size() - 1;
+        auto index = static_cast<size_t>(hash) & mask;
+        while (m_slots[index].count != 0 && m_slots[index].hash != hash) {
+            index = (index + 1) & mask;
+        }
+        return m_slots[index];
+    }
+
+    Slot& find_slot(std::uint64_t hash) {
+        return const_cast<Slot&>(
+            static_cast<const KoHashSet&>(*this).find_slot(hash));
+    }
+
+    void grow() {
+        auto old_slots = std::move(m_slots);
+        m_slots.assign(old_slots.empty() ? 64 : 2 * old_slots.size(),
+                       Slot{0, 0});
+        for (const auto& slot : old_slots) {
+            if (slot.count != 0) {
+                find_slot(slot.hash) = slot;
+            }
+        }
+    }
+
+    std::vector<Slot> m_slots;
+    size_t m_entries{0};
+};
+
+#endif
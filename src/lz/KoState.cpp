@@ -20,8 +20,6 @@
 #include "KoState.h"
 
 #include <cassert>
-#include <algorithm>
-#include <iterator>
 
 #include "FastBoard.h"
 #include "FastState.h"
@@ -33,23 +31,23 @@ void KoState::init_game(int size, float komi) {
     FastState::init_game(size, komi);
 
     m_ko_hash_history.clear();
-    m_ko_hash_history.emplace_back(board.get_ko_hash());
+    m_ko_hash_history.insert(board.get_ko_hash());
 }
 
 bool KoState::superko(void) const {
-    auto first = crbegin(m_ko_hash_history);
-    auto last = crend(m_ko_hash_history);
-
-    auto res = std::find(++first, last, board.get_ko_hash());
+    // The current position is in the history once already.
+    return m_ko_hash_history.count(board.get_ko_hash()) > 1;
+}
 
-    return (res != last);
+bool KoState::in_ko_history(std::uint64_t ko_hash) const {
+    return m_ko_hash_history.count(ko_hash) > 0;
 }
 
 void KoState::reset_game() {
     FastState::reset_game();
 
     m_ko_hash_history.clear();
-    m_ko_hash_history.push_back(board.get_ko_hash());
+    m_ko_hash_history.insert(board.get_ko_hash());
 }
 
 void KoState::play_move(int vertex) {
@@ -60,5 +58,5 @@ void KoState::play_move(int color, int vertex) {
     if (vertex != FastBoard::RESIGN) {
         FastState::play_move(color, vertex);
     }
-    m_ko_hash_history.push_back(board.get_ko_hash());
+    m_ko_hash_history.insert(board.get_ko_hash());
 }
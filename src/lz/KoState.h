@@ -21,22 +21,26 @@
 
 #include "config.h"
 
-#include <vector>
+#include <cstdint>
 
 #include "FastState.h"
 #include "FullBoard.h"
+#include "KoHashSet.h"
 
 class KoState : public FastState {
 public:
     void init_game(int size, float komi);
     bool superko(void) const;
+    // Whether the position ko_hash occurred anywhere in this game.
+    bool in_ko_history(std::uint64_t ko_hash) const;
     void reset_game();
 
     void play_move(int color, int vertex);
     void play_move(int vertex);
 
 private:
-    std::vector<std::uint64_t> m_ko_hash_history;
+    // Every position of the game so far, the current one included.
+    KoHashSet m_ko_hash_history;
 };
 
 #endif
@@ -15,74 +15,449 @@
     You should have received a copy of the GNU General Public License
     along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
 */
-
 #include "config.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <type_traits>
+#include <thread>
+#include <vector>
+#include <boost/format.hpp>
 
 #include "NNCache.h"
+#include "FastBoard.h"
+#include "MappedFile.h"
+#include "Random.h"
+#include "Timing.h"
 #include "Utils.h"
 
-NNCache::NNCache(int size) : m_size(size) {}
+NNCache::NNCache(int size) {
+    resize(size);
+}
 
 NNCache& NNCache::get_NNCache(void) {
     static NNCache cache;
     return cache;
 }
 
-bool NNCache::lookup(std::uint64_t hash, Network::Netresult & result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    ++m_lookups;
+bool NNCache::lookup(std::uint64_t hash, int symmetry,
+                     Network::Netresult & result) {
+    auto& shard = get_shard(hash);
+    std::shared_ptr<const Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.lookups;
 
-    auto iter = m_cache.find(hash);
-    if (iter == m_cache.end()) {
-        return false;  // Not found.
+        auto iter = shard.cache.find(hash);
+        if (iter == shard.cache.end()) {
+            return false;  // Not found.
+        }
+
+        // Found it.
+        ++shard.hits;
+        auto& slot = shard.slots[iter->second];
+        slot.referenced = true;
+        entry = slot.entry;
     }
+    entry->decode(result, symmetry);
+    return true;
+}
 
-    const auto& entry = iter->second;
+// fp16 conversions. Priors are small, so the subnormals are kept and
+// rounding is to nearest even.
+static std::uint16_t float_to_half(float f) {
+    auto x = std::uint32_t{};
+    std::memcpy(&x, &f, sizeof(x));
+    const auto sign = std::uint16_t((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+    if (x >= 0x47800000) {
+        // Too large, infinity or NaN.
+        return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if (x < 0x38800000) {
+        // Subnormal in fp16. Below 2^-25 it rounds to zero.
+        if (x < 0x33000000) {
+            return sign;
+        }
+        const auto shift = 126 - (x >> 23);
+        const auto mantissa = (x & 0x7fffff) | 0x800000;
+        auto h = mantissa >> shift;
+        const auto rest = mantissa & ((1u << shift) - 1);
+        const auto halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (h & 1))) {
+            h++;
+        }
+        return sign | std::uint16_t(h);
+    }
+    // Rebias the exponent from 127 to 15, a carry out of the mantissa
+    // correctly bumps the exponent.
+    auto h = (x >> 13) - (112 << 10);
+    const auto rest = x & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+        h++;
+    }
+    return sign | std::uint16_t(h);
+}
 
-    // Found it.
-    ++m_hits;
-    result = entry->result;
-    return true;
+static float half_to_float(std::uint16_t h) {
+    const auto sign = std::uint32_t(h & 0x8000) << 16;
+    const auto exponent = (h >> 10) & 0x1f;
+    const auto mantissa = std::uint32_t(h & 0x3ff);
+    if (exponent == 0) {
+        const auto f = std::ldexp(float(mantissa), -24);
+        return sign ? -f : f;
+    }
+    auto x = sign | (mantissa << 13);
+    if (exponent == 0x1f) {
+        x |= 0x7f800000;
+    } else {
+        x |= std::uint32_t(exponent + 112) << 23;
+    }
+    auto f = 0.0f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// A NaN that float_to_half never produces.
+static constexpr auto ABSENT = std::uint16_t{0xffff};
+static constexpr auto SQUARE_SIZE = BOARD_SIZE + 2;
+
+// Index of each board point in the orientation of each symmetry.
+using SymmetryTable = std::array<std::array<std::uint16_t, BOARD_SQUARES>, 8>;
+static const SymmetryTable& symmetry_table() {
+    static const auto table = [] {
+        auto t = SymmetryTable{};
+        for (auto s = 0; s < 8; s++) {
+            for (auto idx = 0; idx < BOARD_SQUARES; idx++) {
+                t[s][idx] = std::uint16_t(Network::rotate_nn_idx(idx, s));
+            }
+        }
+        return t;
+    }();
+    return table;
 }
 
-void NNCache::insert(std::uint64_t hash,
+NNCache::Entry::Entry(const Network::Netresult& r, int symmetry)
+    : moves(std::uint16_t(r.first.size())), winrate(r.second) {
+    const auto& to_canonical = symmetry_table()[symmetry];
+    policy.fill(ABSENT);
+    for (const auto& node : r.first) {
+        auto idx = BOARD_SQUARES;
+        if (node.second != FastBoard::PASS) {
+            const auto x = (node.second % SQUARE_SIZE) - 1;
+            const auto y = (node.second / SQUARE_SIZE) - 1;
+            idx = to_canonical[y * BOARD_SIZE + x];
+        }
+        policy[idx] = float_to_half(node.first);
+    }
+}
+
+void NNCache::Entry::decode(Network::Netresult& result, int symmetry) const {
+    const auto& to_canonical = symmetry_table()[symmetry];
+    result.first.clear();
+    result.first.reserve(moves);
+    for (auto y = 0; y < BOARD_SIZE; y++) {
+        for (auto x = 0; x < BOARD_SIZE; x++) {
+            const auto prior = policy[to_canonical[y * BOARD_SIZE + x]];
+            if (prior != ABSENT) {
+                const auto vertex = (y + 1) * SQUARE_SIZE + (x + 1);
+                result.first.emplace_back(half_to_float(prior), vertex);
+            }
+        }
+    }
+    if (policy[BOARD_SQUARES] != ABSENT) {
+        result.first.emplace_back(half_to_float(policy[BOARD_SQUARES]),
+                                  FastBoard::PASS);
+    }
+    result.second = winrate;
+}
+
+void NNCache::insert(std::uint64_t hash, int symmetry,
                      const Network::Netresult& result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    // Built before taking the lock, it is dropped if the hash is already
+    // in the cache.
+    insert_entry(hash, std::make_shared<const Entry>(result, symmetry));
+}
 
-    if (m_cache.find(hash) != m_cache.end()) {
+void NNCache::insert_entry(std::uint64_t hash,
+                           std::shared_ptr<const Entry> entry) {
+    auto& shard = get_shard(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.cache.find(hash) != shard.cache.end()) {
         return;  // Already in the cache.
     }
 
-    m_cache.emplace(hash, std::make_unique<Entry>(result));
-    m_order.push_back(hash);
-    ++m_inserts;
+    ++shard.inserts;
+    // New entries start unreferenced, so that positions looked up only
+    // once are the first to go.
+    auto slot = Slot{hash, std::move(entry), false};
+    if (shard.slots.size() < shard.size) {
+        shard.cache.emplace(hash, shard.slots.size());
+        shard.slots.emplace_back(std::move(slot));
+    } else {
+        const auto index = evict(shard);
+        shard.cache.emplace(hash, index);
+        shard.slots[index] = std::move(slot);
+    }
+}
 
-    // If the cache is too large, remove the oldest entry.
-    if (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+size_t NNCache::evict(Shard& shard) {
+    assert(!shard.slots.empty());
+    // The hand clears the bits it passes, so it stops within one sweep.
+    while (true) {
+        const auto index = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+        auto& slot = shard.slots[index];
+        if (!slot.referenced) {
+            shard.cache.erase(slot.hash);
+            ++shard.evictions;
+            return index;
+        }
+        slot.referenced = false;
     }
 }
 
 void NNCache::resize(int size) {
     m_size = size;
-    while (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+    const auto shard_size = std::max(size_t{1}, m_size / NUM_SHARDS);
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.size = shard_size;
+        while (shard.slots.size() > shard.size) {
+            // Fill the evicted slot with the last one.
+            const auto index = evict(shard);
+            if (index != shard.slots.size() - 1) {
+                shard.slots[index] = std::move(shard.slots.back());
+                shard.cache[shard.slots[index].hash] = index;
+            }
+            shard.slots.pop_back();
+            shard.hand = 0;
+        }
     }
 }
 
+void NNCache::clear() {
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.cache.clear();
+        shard.slots.clear();
+        shard.hand = 0;
+    }
+}
+
+// Snapshot file header, followed by the entries as {key, Entry} records.
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    // SNAPSHOT_BYTE_ORDER as written by the saving machine.
+    std::uint32_t byte_order;
+    std::uint32_t board_size;
+    std::uint32_t entry_size;
+    std::uint64_t weights_hash;
+    std::uint64_t entries;
+};
+static constexpr char SNAPSHOT_MAGIC[8] = {'L', 'Z', 'N', 'N', 'C', 'A', 'C', 'H'};
+static constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+static constexpr std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+bool NNCache::save(const std::string& filename) {
+    static_assert(std::is_trivially_copyable<Entry>::value,
+                  "Entry is written as it is in memory");
+    static_assert(sizeof(Entry) == sizeof(Entry::policy)
+                      + 2 * sizeof(std::uint16_t) + sizeof(float),
+                  "Entry must not have padding");
+    static_assert(sizeof(SnapshotHeader) == 8 + 4 * 4 + 2 * 8,
+                  "SnapshotHeader must not have padding");
+    const auto weights_hash = Network::get_weights_hash();
+    if (weights_hash == 0) {
+        return false;
+    }
+
+    // Take references under the locks and write without holding them.
+    auto entries = std::vector<std::pair<std::uint64_t,
+                                         std::shared_ptr<const Entry>>>{};
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& slot : shard.slots) {
+            entries.emplace_back(slot.hash, slot.entry);
+        }
+    }
+
+    auto out = std::ofstream{filename, std::ios::binary};
+    auto header = SnapshotHeader{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.board_size = BOARD_SIZE;
+    header.entry_size = sizeof(Entry);
+    header.weights_hash = weights_hash;
+    header.entries = entries.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& entry : entries) {
+        out.write(reinterpret_cast<const char*>(&entry.first),
+                  sizeof(entry.first));
+        out.write(reinterpret_cast<const char*>(entry.second.get()),
+                  sizeof(Entry));
+    }
+    out.close();
+    if (out.fail()) {
+        Utils::myprintf("Could not write NNCache file: %s\n", filename.c_str());
+        return false;
+    }
+    Utils::myprintf("Wrote %d NNCache entries to %s.\n",
+                    static_cast<int>(entries.size()), filename.c_str());
+    return true;
+}
+
+int NNCache::load(const std::string& filename) {
+    MappedFile file;
+    if (!file.open(filename) || file.size() < sizeof(SnapshotHeader)) {
+        Utils::myprintf("Could not open NNCache file: %s\n", filename.c_str());
+        return -1;
+    }
+    auto header = SnapshotHeader{};
+    std::memcpy(&header, file.data(), sizeof(header));
+    constexpr auto record_size = sizeof(std::uint64_t) + sizeof(Entry);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION
+        || header.byte_order != SNAPSHOT_BYTE_ORDER
+        || header.board_size != BOARD_SIZE
+        || header.entry_size != sizeof(Entry)
+        || (file.size() - sizeof(header)) / record_size < header.entries) {
+        Utils::myprintf("NNCache file %s is not usable by this build.\n",
+                        filename.c_str());
+        return -1;
+    }
+    if (header.weights_hash != Network::get_weights_hash()) {
+        Utils::myprintf("NNCache file %s is for another network.\n",
+                        filename.c_str());
+        return -1;
+    }
+
+    auto record = file.data() + sizeof(header);
+    for (auto i = std::uint64_t{0}; i < header.entries; i++) {
+        auto hash = std::uint64_t{};
+        std::memcpy(&hash, record, sizeof(hash));
+        auto entry = std::make_shared<Entry>();
+        std::memcpy(entry.get(), record + sizeof(hash), sizeof(Entry));
+        insert_entry(hash, std::move(entry));
+        record += record_size;
+    }
+    // A file bigger than the cache evicts some of its own entries.
+    auto kept = 0;
+    record = file.data() + sizeof(header);
+    for (auto i = std::uint64_t{0}; i < header.entries; i++) {
+        auto hash = std::uint64_t{};
+        std::memcpy(&hash, record, sizeof(hash));
+        auto& shard = get_shard(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        kept += static_cast<int>(shard.cache.count(hash));
+        record += record_size;
+    }
+    Utils::myprintf("Read %d NNCache entries from %s, kept %d.\n",
+                    static_cast<int>(header.entries), filename.c_str(), kept);
+    return kept;
+}
+
+std::pair<int, int> NNCache::hit_rate() {
+    auto hits = 0;
+    auto lookups = 0;
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        hits += shard.hits;
+        lookups += shard.lookups;
+    }
+    return {hits, lookups};
+}
+
 void NNCache::set_size_from_playouts(int max_playouts) {
     // cache hits are generally from last several moves so setting cache
     // size based on playouts increases the hit rate while balancing memory
-    // usage for low playout instances. 50'000 cache entries is ~250 MB
-    auto max_size = std::min(50'000, std::max(6'000, 3 * max_playouts));
+    // usage for low playout instances. 200'000 cache entries is ~200 MB
+    auto max_size = std::min(200'000, std::max(24'000, 12 * max_playouts));
     NNCache::get_NNCache().resize(max_size);
 }
 
 void NNCache::dump_stats() {
-    Utils::myprintf("NNCache: %d/%d hits/lookups = %.1f%% hitrate, %d inserts, %u size\n",
-        m_hits, m_lookups, 100. * m_hits / (m_lookups + 1),
-        m_inserts, m_cache.size());
+    auto hits = 0;
+    auto lookups = 0;
+    auto inserts = 0;
+    auto evictions = 0;
+    auto size = size_t{0};
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        hits += shard.hits;
+        lookups += shard.lookups;
+        inserts += shard.inserts;
+        evictions += shard.evictions;
+        size += shard.cache.size();
+    }
+    Utils::myprintf("NNCache: %d/%d hits/lookups = %.1f%% hitrate, %d inserts, "
+        "%d evictions, %zu size\n",
+        hits, lookups, 100. * hits / (lookups + 1), inserts, evictions, size);
+}
+
+std::string NNCache::benchmark(int max_threads) {
+    constexpr auto OPS_PER_THREAD = 200'000;
+    const auto size = get_NNCache().m_size;
+
+    // A result the size of one from an opening position.
+    auto result = Network::Netresult{};
+    const auto prior = 1.0f / (BOARD_SQUARES + 1);
+    for (auto y = 0; y < BOARD_SIZE; y++) {
+        for (auto x = 0; x < BOARD_SIZE; x++) {
+            result.first.emplace_back(prior, (y + 1) * SQUARE_SIZE + (x + 1));
+        }
+    }
+    result.first.emplace_back(prior, FastBoard::PASS);
+    result.second = 0.5f;
+
+    auto report = std::string{};
+    for (auto threads = 1; threads <= max_threads; threads *= 2) {
+        // Keys are drawn from twice the capacity, so that about half of
+        // the lookups miss and are followed by an insert.
+        NNCache cache(size);
+        auto keys = std::vector<std::uint64_t>(2 * size);
+        auto rng = Random(5489);
+        for (auto& key : keys) {
+            key = rng.randuint64();
+        }
+        for (auto i = size_t{0}; i < size; i++) {
+            cache.insert(keys[i], 0, result);
+        }
+
+        Time start;
+        auto workers = std::vector<std::thread>{};
+        for (auto t = 0; t < threads; t++) {
+            workers.emplace_back([&cache, &keys, &result, t]() {
+                auto rng = Random(t + 1);
+                auto netresult = Network::Netresult{};
+                for (auto op = 0; op < OPS_PER_THREAD; op++) {
+                    const auto key = keys[rng.randuint64(keys.size())];
+                    if (!cache.lookup(key, 0, netresult)) {
+                        cache.insert(key, 0, result);
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        Time end;
+
+        const auto elapsed = Time::timediff_seconds(start, end);
+        const auto ops = double(OPS_PER_THREAD) * threads;
+        const auto hits = cache.hit_rate();
+        auto line = boost::str(boost::format(
+            "%2d threads: %9d lookups/s, %.1f%% hits")
+            % threads % int(ops / elapsed)
+            % (100.0 * hits.first / hits.second));
+        Utils::myprintf("%s\n", line.c_str());
+        report += (report.empty() ? "" : "\n") + line;
+    }
+    return report;
 }
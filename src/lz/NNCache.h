@@ -21,11 +21,19 @@
 
 #include "config.h"
 
-#include <deque>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "FullBoard.h"
 #include "Network.h"
+#include "Zobrist.h"
 
 class NNCache {
 public:
@@ -38,42 +46,155 @@ public:
     // Resize NNCache
     void resize(int size);
 
-    // Try and find an existing entry.
-    bool lookup(std::uint64_t hash, Network::Netresult & result);
+    // Drop all entries.
+    void clear();
 
-    // Insert a new entry.
-    void insert(std::uint64_t hash,
+    // Try and find an existing entry. symmetry is the one get_key gave
+    // for the position, the result is rotated to match it.
+    bool lookup(std::uint64_t hash, int symmetry,
+                Network::Netresult & result);
+
+    // Insert a new entry, stored in the canonical orientation.
+    void insert(std::uint64_t hash, int symmetry,
                 const Network::Netresult& result);
 
+    // Key of the position moves_ago moves back in state. It covers the
+    // stones on the board and on the earlier boards the network sees as
+    // input, and the side to move. It is the same for all 8 symmetric
+    // versions of a position: the smallest of their keys. symmetry is set
+    // to the one that maps the position to that canonical orientation.
+    template <typename State>
+    static std::uint64_t get_key(const State& state, size_t moves_ago = 0,
+                                 int* symmetry = nullptr);
+
+    // Writes all entries to filename, tagged with the hash of the loaded
+    // network.
+    bool save(const std::string& filename);
+    // Inserts the entries of a file written by save for the same network.
+    // Returns the number of its entries the cache holds afterwards, which
+    // is less than the file has if it is bigger than the cache, or -1 if
+    // the file can't be used.
+    int load(const std::string& filename);
+
     // Return the hit rate ratio.
-    std::pair<int, int> hit_rate() const {
-        return {m_hits, m_lookups};
-    }
+    std::pair<int, int> hit_rate();
 
     void dump_stats();
 
-private:
-    NNCache(int size = 50000);  // ~ 250MB
-
-    std::mutex m_mutex;
+    // Lookup and insert throughput of a cache of the current size for
+    // 1, 2, 4, ... up to max_threads threads.
+    static std::string benchmark(int max_threads);
 
-    size_t m_size;
+    // Independently locked parts of the cache, selected by hash bits.
+    static constexpr auto SHARD_BITS = 6;
+    static constexpr auto NUM_SHARDS = 1 << SHARD_BITS;
 
-    // Statistics
-    int m_hits{0};
-    int m_lookups{0};
-    int m_inserts{0};
+private:
+    NNCache(int size = 200000);  // ~ 200MB
 
+    // The policy is kept as fp16 by board index rather than as
+    // {prior, vertex} pairs, which takes it from ~3KB to ~0.7KB.
+    // Plain data, snapshots store it as it is in memory.
     struct Entry {
-        Entry( const Network::Netresult& r)
-            : result(r) {}
-        Network::Netresult result;  // ~ 3KB
+        Entry() = default;
+        Entry(const Network::Netresult& r, int symmetry);
+        // Fills in result with the moves in board order, pass last.
+        void decode(Network::Netresult& result, int symmetry) const;
+
+        // Board points in the canonical orientation then pass, ABSENT
+        // for moves not in the result.
+        std::array<std::uint16_t, BOARD_SQUARES + 1> policy;
+        std::uint16_t moves;
+        // Fills what would be padding, so snapshots hold no stray bytes.
+        std::uint16_t unused{0};
+        float winrate;
+    };
+
+    // Entries are shared so that lookup can copy the result without
+    // holding the lock.
+    struct Slot {
+        std::uint64_t hash;
+        std::shared_ptr<const Entry> entry;
+        // Set by lookup, cleared when the clock hand passes.
+        bool referenced;
+    };
+
+    // Aligned so that the locks of neighbouring shards do not share a
+    // cache line.
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        size_t size{0};
+
+        // Statistics
+        int hits{0};
+        int lookups{0};
+        int inserts{0};
+        int evictions{0};
+
+        // Map from hash to the slot holding it.
+        std::unordered_map<std::uint64_t, size_t> cache;
+        // CLOCK replacement: the hand evicts the first slot that was
+        // not referenced since it last passed.
+        std::vector<Slot> slots;
+        size_t hand{0};
     };
 
-    // Map from hash to {features, result}
-    std::unordered_map<std::uint64_t, std::unique_ptr<const Entry>> m_cache;
-    // Order entries were added to the map.
-    std::deque<size_t> m_order;
+    // Frees a slot of a full shard and returns its index.
+    static size_t evict(Shard& shard);
+    void insert_entry(std::uint64_t hash, std::shared_ptr<const Entry> entry);
+
+    Shard& get_shard(std::uint64_t hash) {
+        // The maps bucket on the low bits, so shard on the high ones.
+        return m_shards[hash >> (64 - SHARD_BITS)];
+    }
+
+    size_t m_size;
+    std::array<Shard, NUM_SHARDS> m_shards;
 };
 
+template <typename State>
+std::uint64_t NNCache::get_key(const State& state, size_t moves_ago,
+                               int* symmetry) {
+    assert(moves_ago <= state.get_movenum());
+    // Boards before the start of the game are empty, with a hash of 0,
+    // the same as the empty planes the network gets for them.
+    const auto boards = std::min<size_t>(state.get_movenum() - moves_ago + 1,
+                                         Network::INPUT_MOVES);
+    std::array<const PastBoard*, Network::INPUT_MOVES> history;
+    for (auto h = size_t{0}; h < boards; h++) {
+        history[h] = &state.get_past_board(int(moves_ago + h));
+    }
+
+    auto best_key = std::uint64_t{0};
+    auto best_symmetry = 0;
+    for (auto s = 0; s < 8; s++) {
+        auto key = history[0]->symmetry_hash[s];
+        // Rotated so that the same boards in another order give another key.
+        for (auto h = size_t{1}; h < boards; h++) {
+            const auto past = history[h]->symmetry_hash[s];
+            key ^= (past << h) | (past >> (64 - h));
+        }
+        if (s == 0 || key < best_key) {
+            best_key = key;
+            best_symmetry = s;
+        }
+    }
+    if (symmetry != nullptr) {
+        *symmetry = best_symmetry;
+    }
+    // The side to move can be set without playing a move, take it from
+    // the state for the position itself.
+    const auto to_move = moves_ago == 0 ? state.get_to_move()
+                                        : history[0]->to_move;
+    if (to_move == FastBoard::BLACK) {
+        best_key ^= Zobrist::zobrist_blacktomove;
+    }
+    // The minimum of 8 keys has mostly zero high bits, which pick the
+    // shard. Mix it so that the shards fill evenly.
+    best_key ^= best_key >> 33;
+    best_key *= 0xff51afd7ed558ccd;
+    best_key ^= best_key >> 33;
+    return best_key;
+}
+
 #endif
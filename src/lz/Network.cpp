@@ -22,8 +22,11 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <sstream>
@@ -46,17 +49,21 @@
 #include "UCTNode.h"
 #endif
 
+#include "Allocations.h"
+#include "BatchScheduler.h"
 #include "FastBoard.h"
 #include "FastState.h"
 #include "FullBoard.h"
 #include "GameState.h"
 #include "GTP.h"
-#include "Im2Col.h"
+#include "Int8Kernels.h"
+#include "MappedFile.h"
 #include "NNCache.h"
 #include "Random.h"
 #include "ThreadPool.h"
 #include "Timing.h"
 #include "Utils.h"
+#include "WinogradKernels.h"
 
 namespace x3 = boost::spirit::x3;
 using namespace Utils;
@@ -91,26 +98,157 @@ static std::array<float, 1> ip2_val_b;
 // Rotation helper
 static std::array<std::array<int, BOARD_SQUARES>, 8> rotate_nn_idx_table;
 
-void Network::benchmark(const GameState * state, int iterations) {
+// Whether the loaded weights are Winograd transformed with the biases
+// folded into the batchnorm means, as the binary format stores them.
+static bool weights_prepared = false;
+// Identifies the loaded network for NNCache snapshots, 0 until loaded.
+static std::uint64_t weights_hash = 0;
+
+// Binary weights file header. The arrays follow in the order of
+// visit_binary_arrays as native floats, each starting at a multiple of
+// BINARY_ALIGN bytes, so that a mapped file can be read in place.
+struct BinaryHeader {
+    char magic[8];
+    std::uint32_t version;
+    // BINARY_BYTE_ORDER as written by the converting machine.
+    std::uint32_t byte_order;
+    std::uint32_t channels;
+    std::uint32_t residual_blocks;
+    std::uint32_t input_channels;
+    std::uint32_t board_size;
+    std::uint64_t file_size;
+};
+static constexpr char BINARY_MAGIC[8] = {'L', 'Z', 'W', 'E', 'I', 'G', 'H', 'T'};
+static constexpr std::uint32_t BINARY_BYTE_ORDER = 0x01020304;
+static constexpr size_t BINARY_ALIGN = 64;
+
+// Optional int8 residual tower, see cfg_int8. Indexed like conv_weights,
+// the input convolution (index 0) always runs in fp32.
+struct Int8Conv {
+    // Int8Kernels::pack_weights layout.
+    std::vector<std::int8_t> weights;
+    // Per output channel.
+    std::vector<float> weight_scales;
+    // Activation scale, set by Network::calibrate_int8.
+    float input_scale{1.0f};
+    int channels{0};
+    int outputs{0};
+};
+static std::vector<Int8Conv> int8_convs;
+// Precision of the searches, set once by Network::initialize.
+static Network::Precision tower_precision = Network::FP32;
+// Largest input seen by each tower convolution while calibrating.
+static std::vector<float>* int8_calibration = nullptr;
+
+// Buffers for the evaluations of one thread. They are sized from the
+// loaded network the first time a thread evaluates and reused after
+// that, so that evaluations don't allocate.
+struct NNWorkspace {
+    NNWorkspace() {
+        constexpr auto tiles = (BOARD_SIZE + 1) * (BOARD_SIZE + 1) / 4;
+        const auto channels = conv_biases[0].size();
+        const auto input_channels =
+            std::max(channels, size_t{Network::INPUT_CHANNELS});
+        // --average-symmetries runs all symmetries as one batch.
+        const auto batch = size_t(std::max(std::max(1, cfg_batch_size),
+            cfg_average_symmetries ? Network::NUM_SYMMETRIES : 1));
+
+        planes.resize(Network::INPUT_CHANNELS);
+        input_data.resize(Network::INPUT_CHANNELS * BOARD_SQUARES);
+        policy_data.resize(Network::OUTPUTS_POLICY * BOARD_SQUARES);
+        value_data.resize(Network::OUTPUTS_VALUE * BOARD_SQUARES);
+        policy_out.resize(BOARD_SQUARES + 1);
+        softmax_data.resize(BOARD_SQUARES + 1);
+        winrate_data.resize(256);
+        winrate_out.resize(1);
+
+        // forward_cpu resizes these to the batch it runs, which stays
+        // within the capacity reserved here.
+        conv_out.reserve(batch * channels * BOARD_SQUARES);
+        conv_in.reserve(batch * channels * BOARD_SQUARES);
+        V.reserve(batch * Network::WINOGRAD_TILE * input_channels * tiles);
+        M.reserve(batch * Network::WINOGRAD_TILE * channels * tiles);
+    }
+
+    // get_scored_moves
+    Network::NNPlanes planes;
+    std::vector<float> input_data;
+    std::vector<float> policy_data;
+    std::vector<float> value_data;
+    std::vector<float> policy_out;
+    std::vector<float> softmax_data;
+    std::vector<float> winrate_data;
+    std::vector<float> winrate_out;
+
+    // get_scored_moves_average, sized when first used.
+    std::vector<float> ensemble_input;
+    std::vector<float> ensemble_policy;
+    std::vector<float> ensemble_value;
+    std::vector<float> ensemble_outputs;
+
+    // forward_cpu
+    std::vector<float> conv_out;
+    std::vector<float> conv_in;
+    std::vector<float> V;
+    std::vector<float> M;
+
+    // int8_convolve3, sized when first used.
+    std::vector<std::uint8_t> int8_act;
+    std::vector<std::int32_t> int8_sums;
+};
+
+static NNWorkspace& get_workspace() {
+    thread_local NNWorkspace workspace;
+    return workspace;
+}
+
+// Calibration positions: every 4th position of these openings. Lower
+// case, as GameState::play_textmove expects.
+static const std::array<const char*, 4> int8_calibration_games = {{
+    "q16 d4 q3 d16 r5 c14 f17 c6 o4 r14 r15 q14 p14 p13 o13 o14 "
+    "n14 o15 p15 n13 o12 n15 m14 m15 l14 l15 k14 q10 c10 d10",
+    "r16 d17 q3 d4 c15 e16 c12 r5 q5 q6 p5 r6 r3 s4 s3 p6 "
+    "o5 o6 n5 r9 f3 c5 j4 p16 q16 p15 r14 p13 k16 d11",
+    "q4 d16 q16 c4 e3 d3 e4 c6 h3 r6 r5 q6 p5 o3 p3 n4 "
+    "o4 n5 o6 n6 o7 q10 f16 c13 e17 d17 e16 d15 h17 k16",
+    "k10 d4 q16 q4 d16 c14 e17 r14 p3 o4 p4 p5 q5 o3 q3 r6 "
+    "r5 n2 f3 c6 d3 e3 e2 f4 g3 c3 e4 r17 q17 r16 q15 o17"
+}};
+
+std::string Network::benchmark(const GameState * state, int iterations) {
     int cpus = cfg_num_threads;
     int iters_per_thread = (iterations + (cpus - 1)) / cpus;
 
     Time start;
 
+    const auto search_state = SearchState(*state);
+    std::atomic<std::uint64_t> allocations{0};
     ThreadGroup tg(thread_pool);
     for (int i = 0; i < cpus; i++) {
-        tg.add_task([iters_per_thread, state]() {
+        tg.add_task([iters_per_thread, &search_state, &allocations]() {
+            // Sets up the workspace of this thread first.
+            get_scored_moves(&search_state, Ensemble::RANDOM_ROTATION, -1, true);
+            const auto before = Allocations::thread_count();
             for (int loop = 0; loop < iters_per_thread; loop++) {
-                auto vec = get_scored_moves(state, Ensemble::RANDOM_ROTATION, -1, true);
+                auto vec = get_scored_moves(&search_state, Ensemble::RANDOM_ROTATION, -1, true);
             }
+            allocations += Allocations::thread_count() - before;
         });
     };
     tg.wait_all();
 
     Time end;
     auto elapsed = Time::timediff_seconds(start,end);
-    myprintf("%5d evaluations in %5.2f seconds -> %d n/s\n",
-             iterations, elapsed, (int)(iterations / elapsed));
+    auto evaluations = iters_per_thread * cpus;
+    auto report = boost::str(boost::format(
+        "%5d evaluations in %5.2f seconds -> %d n/s")
+        % evaluations % elapsed % int(evaluations / elapsed));
+    if (Allocations::enabled()) {
+        report += boost::str(boost::format(", %.2f allocations per evaluation")
+                             % (double(allocations) / evaluations));
+    }
+    myprintf("%s\n", report.c_str());
+    return report;
 }
 
 void Network::process_bn_var(std::vector<float>& weights, const float epsilon) {
@@ -189,70 +327,111 @@ std::vector<float> Network::zeropad_U(const std::vector<float>& U,
     return Upad;
 }
 
+// Runs f(i) for every i in [0, count) on the thread pool. Before the pool
+// is started (e.g. when only converting weights) it runs on this thread.
+template <typename F>
+static void parallel_for(size_t count, F f) {
+    const auto workers = std::min(count, thread_pool.size());
+    if (workers <= 1) {
+        for (auto i = size_t{0}; i < count; i++) {
+            f(i);
+        }
+        return;
+    }
+    std::atomic<size_t> next{0};
+    ThreadGroup tg(thread_pool);
+    for (auto w = size_t{0}; w < workers; w++) {
+        tg.add_task([count, &next, &f]() {
+            for (auto i = next++; i < count; i = next++) {
+                f(i);
+            }
+        });
+    }
+    tg.wait_all();
+}
+
 std::pair<int, int>  Network::load_v1_network(std::ifstream& wtfile) {
+    // Read the rest of the file in one go, the version line is already done.
+    const auto start = wtfile.tellg();
+    wtfile.seekg(0, std::ios::end);
+    auto text = std::string(static_cast<size_t>(wtfile.tellg() - start), '\0');
+    wtfile.seekg(start);
+    wtfile.read(&text[0], text.size());
+    text.resize(static_cast<size_t>(wtfile.gcount()));
+    wtfile.close();
+
+    // Split by line offsets so that the lines can be parsed concurrently.
+    auto lines = std::vector<std::pair<const char*, const char*>>{};
+    auto pos = text.data();
+    const auto text_end = text.data() + text.size();
+    while (pos != text_end) {
+        auto eol = static_cast<const char*>(
+            std::memchr(pos, '\n', text_end - pos));
+        if (eol == nullptr) {
+            eol = text_end;
+        }
+        lines.emplace_back(pos, eol);
+        pos = (eol == text_end) ? eol : eol + 1;
+    }
+
     // Count size of the network
     myprintf("Detecting residual layers...");
     // We are version 1
     myprintf("v%d...", 1);
-    // First line was the version number
-    auto linecount = size_t{1};
-    auto channels = 0;
-    auto line = std::string{};
-    while (std::getline(wtfile, line)) {
-        auto iss = std::stringstream{line};
-        // Third line of parameters are the convolution layer biases,
-        // so this tells us the amount of channels in the residual layers.
-        // We are assuming all layers have the same amount of filters.
-        if (linecount == 2) {
-            auto count = std::distance(std::istream_iterator<std::string>(iss),
-                                       std::istream_iterator<std::string>());
-            myprintf("%d channels...", count);
-            channels = count;
-        }
-        linecount++;
-    }
     // 1 format id, 1 input layer (4 x weights), 14 ending weights,
     // the rest are residuals, every residual has 8 x weight lines
+    auto linecount = lines.size() + 1;
+    if (linecount < 1 + 4 + 14) {
+        myprintf("\nInconsistent number of weights in the file.\n");
+        return {0, 0};
+    }
     auto residual_blocks = linecount - (1 + 4 + 14);
     if (residual_blocks % 8 != 0) {
         myprintf("\nInconsistent number of weights in the file.\n");
         return {0, 0};
     }
     residual_blocks /= 8;
-    myprintf("%d blocks.\n", residual_blocks);
 
-    // Re-read file and process
-    wtfile.clear();
-    wtfile.seekg(0, std::ios::beg);
+    auto parsed = std::vector<std::vector<float>>(lines.size());
+    std::atomic<size_t> first_error{lines.size()};
+    parallel_for(lines.size(), [&lines, &parsed, &first_error](size_t i) {
+        auto it_line = lines[i].first;
+        auto ok = phrase_parse(it_line, lines[i].second,
+                               *x3::float_, x3::space, parsed[i]);
+        if (!ok || it_line != lines[i].second) {
+            auto error = first_error.load();
+            while (i < error && !first_error.compare_exchange_weak(error, i)) {}
+        }
+    });
+    if (first_error < lines.size()) {
+        myprintf("\nFailed to parse weight file. Error on line %zu.\n",
+                 first_error + 2); //+1 from version line, +1 from 0-indexing
+        return {0, 0};
+    }
 
-    // Get the file format id out of the way
-    std::getline(wtfile, line);
+    // Second line of parameters are the convolution layer biases,
+    // so this tells us the amount of channels in the residual layers.
+    // We are assuming all layers have the same amount of filters.
+    auto channels = static_cast<int>(parsed[1].size());
+    myprintf("%d channels...", channels);
+    myprintf("%zu blocks.\n", residual_blocks);
 
     auto plain_conv_layers = 1 + (residual_blocks * 2);
     auto plain_conv_wts = plain_conv_layers * 4;
-    linecount = 0;
-    while (std::getline(wtfile, line)) {
-        std::vector<float> weights;
-        auto it_line = line.begin();
-        auto ok = phrase_parse(it_line, line.end(),
-                               *x3::float_, x3::space, weights);
-        if (!ok || it_line != line.end()) {
-            myprintf("\nFailed to parse weight file. Error on line %d.\n",
-                    linecount + 2); //+1 from version line, +1 from 0-indexing
-            return {0,0};
-        }
+    for (linecount = 0; linecount < parsed.size(); linecount++) {
+        auto& weights = parsed[linecount];
         if (linecount < plain_conv_wts) {
             if (linecount % 4 == 0) {
-                conv_weights.emplace_back(weights);
+                conv_weights.emplace_back(std::move(weights));
             } else if (linecount % 4 == 1) {
                 // Redundant in our model, but they encode the
                 // number of outputs so we have to read them in.
-                conv_biases.emplace_back(weights);
+                conv_biases.emplace_back(std::move(weights));
             } else if (linecount % 4 == 2) {
-                batchnorm_means.emplace_back(weights);
+                batchnorm_means.emplace_back(std::move(weights));
             } else if (linecount % 4 == 3) {
                 process_bn_var(weights);
-                batchnorm_stddivs.emplace_back(weights);
+                batchnorm_stddivs.emplace_back(std::move(weights));
             }
         } else if (linecount == plain_conv_wts) {
             conv_pol_w = std::move(weights);
@@ -285,14 +464,303 @@ std::pair<int, int>  Network::load_v1_network(std::ifstream& wtfile) {
         } else if (linecount == plain_conv_wts + 13) {
             std::copy(begin(weights), end(weights), begin(ip2_val_b));
         }
-        linecount++;
     }
-    wtfile.close();
 
     return {channels, residual_blocks};
 }
 
+static size_t align_binary(size_t offset) {
+    return (offset + BINARY_ALIGN - 1) / BINARY_ALIGN * BINARY_ALIGN;
+}
+
+static bool has_binary_magic(const std::string& filename) {
+    auto wtfile = std::ifstream{filename, std::ios::binary};
+    char magic[sizeof(BINARY_MAGIC)];
+    return wtfile.read(magic, sizeof(magic))
+           && std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+// Sizes the network for reading a binary file. The biases stay zero,
+// they are folded into the batchnorm means.
+static void resize_network(size_t channels, size_t residual_blocks) {
+    conv_weights.clear();
+    conv_biases.clear();
+    batchnorm_means.clear();
+    batchnorm_stddivs.clear();
+    for (auto i = size_t{0}; i < 1 + 2 * residual_blocks; i++) {
+        const auto inputs = i == 0 ? size_t{Network::INPUT_CHANNELS}
+                                   : channels;
+        conv_weights.emplace_back(Network::WINOGRAD_TILE * channels * inputs);
+        conv_biases.emplace_back(channels);
+        batchnorm_means.emplace_back(channels);
+        batchnorm_stddivs.emplace_back(channels);
+    }
+    conv_pol_w.assign(Network::OUTPUTS_POLICY * channels, 0.0f);
+    conv_pol_b.assign(Network::OUTPUTS_POLICY, 0.0f);
+    conv_val_w.assign(Network::OUTPUTS_VALUE * channels, 0.0f);
+    conv_val_b.assign(Network::OUTPUTS_VALUE, 0.0f);
+}
+
+// Calls f(data, count) for each array of the binary format in file
+// order. data is null for the 3x3 weights when raw_weights is empty.
+template <typename F>
+static void visit_binary_arrays(std::vector<std::vector<float>>& raw_weights,
+                                F f) {
+    for (auto i = size_t{0}; i < conv_weights.size(); i++) {
+        f(conv_weights[i].data(), conv_weights[i].size());
+        f(batchnorm_means[i].data(), batchnorm_means[i].size());
+        f(batchnorm_stddivs[i].data(), batchnorm_stddivs[i].size());
+    }
+    // The weights before the Winograd transform, only read for --int8.
+    for (auto i = size_t{0}; i < conv_weights.size(); i++) {
+        const auto count = conv_weights[i].size() / Network::WINOGRAD_TILE * 9;
+        f(raw_weights.empty() ? nullptr : raw_weights[i].data(), count);
+    }
+    f(conv_pol_w.data(), conv_pol_w.size());
+    f(bn_pol_w1.data(), bn_pol_w1.size());
+    f(bn_pol_w2.data(), bn_pol_w2.size());
+    f(ip_pol_w.data(), ip_pol_w.size());
+    f(ip_pol_b.data(), ip_pol_b.size());
+    f(conv_val_w.data(), conv_val_w.size());
+    f(bn_val_w1.data(), bn_val_w1.size());
+    f(bn_val_w2.data(), bn_val_w2.size());
+    f(ip1_val_w.data(), ip1_val_w.size());
+    f(ip1_val_b.data(), ip1_val_b.size());
+    f(ip2_val_w.data(), ip2_val_w.size());
+    f(ip2_val_b.data(), ip2_val_b.size());
+}
+
+// Size of the binary file of a network of this shape. Follows
+// visit_binary_arrays, but needs nothing allocated, so that the header
+// can be checked against the file before resize_network.
+static size_t binary_file_size(size_t channels, size_t residual_blocks) {
+    auto size = align_binary(sizeof(BinaryHeader));
+    auto add = [&size](size_t count) {
+        size += align_binary(count * sizeof(float));
+    };
+    for (auto i = size_t{0}; i < 1 + 2 * residual_blocks; i++) {
+        const auto inputs = i == 0 ? size_t{Network::INPUT_CHANNELS}
+                                   : channels;
+        add(Network::WINOGRAD_TILE * channels * inputs);
+        add(channels);
+        add(channels);
+        add(9 * channels * inputs);
+    }
+    add(Network::OUTPUTS_POLICY * channels);
+    add(bn_pol_w1.size());
+    add(bn_pol_w2.size());
+    add(ip_pol_w.size());
+    add(ip_pol_b.size());
+    add(Network::OUTPUTS_VALUE * channels);
+    add(bn_val_w1.size());
+    add(bn_val_w2.size());
+    add(ip1_val_w.size());
+    add(ip1_val_b.size());
+    add(ip2_val_w.size());
+    add(ip2_val_b.size());
+    return size;
+}
+
+// FNV-1a over 32-bit words of the prepared arrays, so that the text and
+// binary files of a network give the same hash. Settings that change the
+// outputs are mixed in as well.
+static std::uint64_t hash_weights() {
+    constexpr auto prime = std::uint64_t{0x100000001b3};
+    auto hash = std::uint64_t{0xcbf29ce484222325};
+    auto mix = [&hash](std::uint32_t word) {
+        hash = (hash ^ word) * prime;
+    };
+    auto no_raw_weights = std::vector<std::vector<float>>{};
+    visit_binary_arrays(no_raw_weights, [&mix](const float* data, size_t count) {
+        if (data == nullptr) {
+            return;
+        }
+        for (auto i = size_t{0}; i < count; i++) {
+            auto word = std::uint32_t{};
+            std::memcpy(&word, data + i, sizeof(word));
+            mix(word);
+        }
+    });
+    auto temperature = std::uint32_t{};
+    std::memcpy(&temperature, &cfg_softmax_temp, sizeof(temperature));
+    mix(temperature);
+    mix(cfg_int8 ? 1 : 0);
+    return hash;
+}
+
+std::uint64_t Network::get_weights_hash() {
+    return weights_hash;
+}
+
+static bool valid_binary_header(const BinaryHeader& header) {
+    return std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0
+           && header.version == Network::BINARY_VERSION
+           && header.byte_order == BINARY_BYTE_ORDER
+           && header.input_channels == Network::INPUT_CHANNELS
+           && header.board_size == BOARD_SIZE
+           && header.channels > 0;
+}
+
+std::pair<int, int> Network::load_binary_network(const std::string& filename) {
+    myprintf("Detecting residual layers...binary...");
+    MappedFile file;
+    if (!file.open(filename) || file.size() < sizeof(BinaryHeader)) {
+        myprintf("\nCould not read weights file: %s\n", filename.c_str());
+        return {0, 0};
+    }
+    BinaryHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (!valid_binary_header(header)) {
+        myprintf("\nWeights file is the wrong version, or was converted "
+                 "on a machine with another byte order.\n");
+        return {0, 0};
+    }
+    const auto channels = size_t{header.channels};
+    const auto residual_blocks = size_t{header.residual_blocks};
+    myprintf("%zu channels...%zu blocks.\n", channels, residual_blocks);
+
+    // A shape whose first layers alone don't fit in the file is corrupt,
+    // and could overflow the size computed below.
+    const auto floats = file.size() / sizeof(float);
+    const auto tile = size_t{WINOGRAD_TILE};
+    auto fits = channels <= floats / (tile * INPUT_CHANNELS);
+    if (fits && residual_blocks > 0) {
+        fits = channels <= floats / (tile * channels)
+               && residual_blocks <= floats / (2 * tile * channels * channels);
+    }
+    if (!fits || binary_file_size(channels, residual_blocks) != file.size()
+        || header.file_size != file.size()) {
+        myprintf("Weights file has the wrong size.\n");
+        return {0, 0};
+    }
+
+    resize_network(channels, residual_blocks);
+    auto raw_weights = std::vector<std::vector<float>>{};
+    if (cfg_int8) {
+        for (const auto& U : conv_weights) {
+            raw_weights.emplace_back(U.size() / WINOGRAD_TILE * 9);
+        }
+    }
+
+    auto offset = align_binary(sizeof(BinaryHeader));
+    visit_binary_arrays(raw_weights, [&](float* data, size_t count) {
+        const auto bytes = count * sizeof(float);
+        assert(offset + bytes <= file.size());
+        if (data) {
+            std::memcpy(data, file.data() + offset, bytes);
+        }
+        offset = align_binary(offset + bytes);
+    });
+    assert(offset == file.size());
+    weights_prepared = true;
+
+#if defined(USE_BLAS) && !defined(USE_OPENCL)
+    if (cfg_int8) {
+        quantize_int8_weights(raw_weights);
+    }
+#endif
+    return {channels, residual_blocks};
+}
+
+bool Network::write_binary_network(
+    const std::string& filename, size_t channels, size_t residual_blocks,
+    std::vector<std::vector<float>>& raw_weights) {
+    auto header = BinaryHeader{};
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.byte_order = BINARY_BYTE_ORDER;
+    header.channels = channels;
+    header.residual_blocks = residual_blocks;
+    header.input_channels = INPUT_CHANNELS;
+    header.board_size = BOARD_SIZE;
+    header.file_size = align_binary(sizeof(BinaryHeader));
+    visit_binary_arrays(raw_weights, [&](float*, size_t count) {
+        header.file_size = align_binary(header.file_size
+                                        + count * sizeof(float));
+    });
+
+    auto out = std::ofstream{filename, std::ios::binary};
+    if (!out) {
+        myprintf("Could not open %s for writing.\n", filename.c_str());
+        return false;
+    }
+    auto offset = size_t{0};
+    auto write_aligned = [&](const char* data, size_t bytes) {
+        static const char zeros[BINARY_ALIGN] = {};
+        out.write(data, bytes);
+        offset += bytes;
+        out.write(zeros, align_binary(offset) - offset);
+        offset = align_binary(offset);
+    };
+    write_aligned(reinterpret_cast<const char*>(&header), sizeof(header));
+    visit_binary_arrays(raw_weights, [&](float* data, size_t count) {
+        write_aligned(reinterpret_cast<const char*>(data),
+                      count * sizeof(float));
+    });
+    out.close();
+    assert(out.fail() || offset == header.file_size);
+    return !out.fail();
+}
+
+bool Network::convert_weights(const std::string& text_file,
+                              const std::string& binary_file) {
+    size_t channels, residual_blocks;
+    std::tie(channels, residual_blocks) = load_network_file(text_file);
+    if (channels == 0) {
+        return false;
+    }
+    if (weights_prepared) {
+        myprintf("%s is already in the binary format.\n", text_file.c_str());
+        return false;
+    }
+    auto raw_weights = conv_weights;
+    prepare_weights(channels, residual_blocks);
+    if (!write_binary_network(binary_file, channels, residual_blocks,
+                              raw_weights)) {
+        return false;
+    }
+    myprintf("Wrote %s.\n", binary_file.c_str());
+    return true;
+}
+
+std::pair<int, int> Network::peek_weights_file(const std::string& filename) {
+    auto wtfile = std::ifstream{filename, std::ios::binary};
+    BinaryHeader header;
+    if (wtfile.read(reinterpret_cast<char*>(&header), sizeof(header))
+        && std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+        wtfile.seekg(0, std::ios::end);
+        if (!valid_binary_header(header)
+            || header.file_size != std::uint64_t(wtfile.tellg())) {
+            return {0, 0};
+        }
+        return {header.channels, header.residual_blocks};
+    }
+
+    // v1 text: the third line has the input convolution biases, one
+    // per channel. Only counting all lines would give the blocks.
+    wtfile.clear();
+    wtfile.seekg(0, std::ios::beg);
+    auto line = std::string{};
+    auto format_version = -1;
+    if (!std::getline(wtfile, line)) {
+        return {0, 0};
+    }
+    std::istringstream(line) >> format_version;
+    if (format_version != FORMAT_VERSION
+        || !std::getline(wtfile, line) || !std::getline(wtfile, line)) {
+        return {0, 0};
+    }
+    auto iss = std::istringstream{line};
+    auto channels = std::distance(std::istream_iterator<std::string>(iss),
+                                  std::istream_iterator<std::string>());
+    return {static_cast<int>(channels), 0};
+}
+
 std::pair<int, int> Network::load_network_file(std::string filename) {
+    if (has_binary_magic(filename)) {
+        return load_binary_network(filename);
+    }
+
     auto wtfile = std::ifstream{filename};
     if (wtfile.fail()) {
         myprintf("Could not open weights file: %s\n", filename.c_str());
@@ -318,36 +786,15 @@ std::pair<int, int> Network::load_network_file(std::string filename) {
     return {0, 0};
 }
 
-void Network::initialize(void) {
-    // Prepare rotation table
-    for(auto s = 0; s < 8; s++) {
-        for(auto v = 0; v < BOARD_SQUARES; v++) {
-            rotate_nn_idx_table[s][v] = rotate_nn_idx(v, s);
-        }
-    }
-
-    // Load network from file
-    size_t channels, residual_blocks;
-    std::tie(channels, residual_blocks) = load_network_file(cfg_weightsfile);
-    if (channels == 0) {
-        exit(EXIT_FAILURE);
-    }
-
-    auto weight_index = size_t{0};
-    // Input convolution
-    // Winograd transform convolution weights
-    conv_weights[weight_index] =
-        winograd_transform_f(conv_weights[weight_index],
-                             channels, INPUT_CHANNELS);
-    weight_index++;
-
-    // Residual block convolutions
-    for (auto i = size_t{0}; i < residual_blocks * 2; i++) {
-		conv_weights[weight_index] =
+void Network::prepare_weights(size_t channels, size_t residual_blocks) {
+    // Winograd transform convolution weights, the input convolution first
+    // and then the residual block convolutions. The layers are independent.
+    parallel_for(1 + residual_blocks * 2, [channels](size_t weight_index) {
+        auto inputs = (weight_index == 0) ? size_t{INPUT_CHANNELS} : channels;
+        conv_weights[weight_index] =
             winograd_transform_f(conv_weights[weight_index],
-                                 channels, channels);
-        weight_index++;
-    }
+                                 channels, inputs);
+    });
 
     // Biases are not calculated and are typically zero but some networks might
     // still have non-zero biases.
@@ -369,6 +816,33 @@ void Network::initialize(void) {
         bn_pol_w1[i] -= conv_pol_b[i];
         conv_pol_b[i] = 0.0f;
     }
+}
+
+void Network::initialize(void) {
+    // Prepare rotation table
+    for(auto s = 0; s < 8; s++) {
+        for(auto v = 0; v < BOARD_SQUARES; v++) {
+            rotate_nn_idx_table[s][v] = rotate_nn_idx(v, s);
+        }
+    }
+
+    // Load network from file
+    size_t channels, residual_blocks;
+    std::tie(channels, residual_blocks) = load_network_file(cfg_weightsfile);
+    if (channels == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // The binary format has them prepared already.
+    if (!weights_prepared) {
+#if defined(USE_BLAS) && !defined(USE_OPENCL)
+        if (cfg_int8) {
+            quantize_int8_weights(conv_weights);
+        }
+#endif
+        prepare_weights(channels, residual_blocks);
+    }
+    weights_hash = hash_weights();
 
 #ifdef USE_OPENCL
     myprintf("Initializing OpenCL.\n");
@@ -381,7 +855,7 @@ void Network::initialize(void) {
         auto kwg = tuners[2];
         auto vwm = tuners[3];
 
-        weight_index = 0;
+        auto weight_index = size_t{0};
 
         size_t m_ceil = ceilMultiple(ceilMultiple(channels, mwg), vwm);
         size_t k_ceil = ceilMultiple(ceilMultiple(INPUT_CHANNELS, kwg), vwm);
@@ -432,89 +906,119 @@ void Network::initialize(void) {
     myprintf("BLAS core: MKL %s\n", Version.Processor);
 #endif
 #endif
+#ifndef USE_OPENCL
+    myprintf("Winograd transforms: %s\n",
+             WinogradKernels::get_isa_name(WinogradKernels::get_isa()));
+    if (cfg_int8) {
+        calibrate_int8();
+        tower_precision = INT8;
+    }
+    batch_scheduler.initialize(
+        cfg_batch_size, cfg_batch_wait_us,
+        [](std::vector<float>& input, std::vector<float>& output_pol,
+           std::vector<float>& output_val) {
+            forward_cpu(input, output_pol, output_val, tower_precision);
+        });
+#endif
 #endif
 }
 
 #ifdef USE_BLAS
 void Network::winograd_transform_in(const std::vector<float>& in,
                                     std::vector<float>& V,
-                                    const int C) {
+                                    const int C, const int batch_size) {
+    using WinogradKernels::Isa;
+    const auto isa = WinogradKernels::get_isa();
+    if (isa == Isa::AVX512 && WinogradKernels::transform_in_avx512(
+            in.data(), V.data(), C, batch_size)) {
+        return;
+    }
+    if (isa != Isa::SCALAR && WinogradKernels::transform_in_avx2(
+            in.data(), V.data(), C, batch_size)) {
+        return;
+    }
+
     constexpr auto W = BOARD_SIZE;
     constexpr auto H = BOARD_SIZE;
     constexpr auto wtiles = (W + 1) / 2;
     constexpr auto P = wtiles * wtiles;
+    // All positions of the batch are laid out next to each other in V,
+    // so one SGEMM per tile element covers the whole batch.
+    const auto batch_P = batch_size * P;
 
-    for (auto ch = 0; ch < C; ch++) {
-        for (auto block_y = 0; block_y < wtiles; block_y++) {
-            for (auto block_x = 0; block_x < wtiles; block_x++) {
-
-                // Tiles overlap by 2
-                const auto yin = 2 * block_y - 1;
-                const auto xin = 2 * block_x - 1;
-
-                // Cache input tile and handle zero padding
-                using WinogradTile =
-                    std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_ALPHA>;
-                WinogradTile x;
-
-                for (auto i = 0; i < WINOGRAD_ALPHA; i++) {
-                    for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
-                        if ((yin + i) >= 0 && (xin + j) >= 0
-                            && (yin + i) < H && (xin + j) < W) {
-                            x[i][j] = in[ch*(W*H) + (yin+i)*W + (xin+j)];
-                        } else {
-                            x[i][j] = 0.0f;
+    for (auto n = 0; n < batch_size; n++) {
+        for (auto ch = 0; ch < C; ch++) {
+            for (auto block_y = 0; block_y < wtiles; block_y++) {
+                for (auto block_x = 0; block_x < wtiles; block_x++) {
+
+                    // Tiles overlap by 2
+                    const auto yin = 2 * block_y - 1;
+                    const auto xin = 2 * block_x - 1;
+
+                    // Cache input tile and handle zero padding
+                    using WinogradTile =
+                        std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_ALPHA>;
+                    WinogradTile x;
+
+                    for (auto i = 0; i < WINOGRAD_ALPHA; i++) {
+                        for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
+                            if ((yin + i) >= 0 && (xin + j) >= 0
+                                && (yin + i) < H && (xin + j) < W) {
+                                x[i][j] = in[(n*C + ch)*(W*H) + (yin+i)*W + (xin+j)];
+                            } else {
+                                x[i][j] = 0.0f;
+                            }
                         }
                     }
-                }
 
-                const auto offset = ch*P + block_y*wtiles + block_x;
-
-                // Calculates transpose(B).x.B
-                // B = [[ 1.0,  0.0,  0.0,  0.0],
-                //      [ 0.0,  1.0, -1.0,  1.0],
-                //      [-1.0,  1.0,  1.0,  0.0],
-                //      [ 0.0,  0.0,  0.0, -1.0]]
-
-                WinogradTile T1, T2;
-
-                T1[0][0] = x[0][0] - x[2][0];
-                T1[0][1] = x[0][1] - x[2][1];
-                T1[0][2] = x[0][2] - x[2][2];
-                T1[0][3] = x[0][3] - x[2][3];
-                T1[1][0] = x[1][0] + x[2][0];
-                T1[1][1] = x[1][1] + x[2][1];
-                T1[1][2] = x[1][2] + x[2][2];
-                T1[1][3] = x[1][3] + x[2][3];
-                T1[2][0] = x[2][0] - x[1][0];
-                T1[2][1] = x[2][1] - x[1][1];
-                T1[2][2] = x[2][2] - x[1][2];
-                T1[2][3] = x[2][3] - x[1][3];
-                T1[3][0] = x[1][0] - x[3][0];
-                T1[3][1] = x[1][1] - x[3][1];
-                T1[3][2] = x[1][2] - x[3][2];
-                T1[3][3] = x[1][3] - x[3][3];
-
-                T2[0][0] = T1[0][0] - T1[0][2];
-                T2[0][1] = T1[0][1] + T1[0][2];
-                T2[0][2] = T1[0][2] - T1[0][1];
-                T2[0][3] = T1[0][1] - T1[0][3];
-                T2[1][0] = T1[1][0] - T1[1][2];
-                T2[1][1] = T1[1][1] + T1[1][2];
-                T2[1][2] = T1[1][2] - T1[1][1];
-                T2[1][3] = T1[1][1] - T1[1][3];
-                T2[2][0] = T1[2][0] - T1[2][2];
-                T2[2][1] = T1[2][1] + T1[2][2];
-                T2[2][2] = T1[2][2] - T1[2][1];
-                T2[2][3] = T1[2][1] - T1[2][3];
-                T2[3][0] = T1[3][0] - T1[3][2];
-                T2[3][1] = T1[3][1] + T1[3][2];
-                T2[3][2] = T1[3][2] - T1[3][1];
-                T2[3][3] = T1[3][1] - T1[3][3];
-
-                for (auto i = 0; i < WINOGRAD_ALPHA; i++) {
-                    for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
-                        V[(i*WINOGRAD_ALPHA + j)*C*P + offset] = T2[i][j];
+                    const auto offset = ch*batch_P + n*P + block_y*wtiles + block_x;
+
+                    // Calculates transpose(B).x.B
+                    // B = [[ 1.0,  0.0,  0.0,  0.0],
+                    //      [ 0.0,  1.0, -1.0,  1.0],
+                    //      [-1.0,  1.0,  1.0,  0.0],
+                    //      [ 0.0,  0.0,  0.0, -1.0]]
+
+                    WinogradTile T1, T2;
+
+                    T1[0][0] = x[0][0] - x[2][0];
+                    T1[0][1] = x[0][1] - x[2][1];
+                    T1[0][2] = x[0][2] - x[2][2];
+                    T1[0][3] = x[0][3] - x[2][3];
+                    T1[1][0] = x[1][0] + x[2][0];
+                    T1[1][1] = x[1][1] + x[2][1];
+                    T1[1][2] = x[1][2] + x[2][2];
+                    T1[1][3] = x[1][3] + x[2][3];
+                    T1[2][0] = x[2][0] - x[1][0];
+                    T1[2][1] = x[2][1] - x[1][1];
+                    T1[2][2] = x[2][2] - x[1][2];
+                    T1[2][3] = x[2][3] - x[1][3];
+                    T1[3][0] = x[1][0] - x[3][0];
+                    T1[3][1] = x[1][1] - x[3][1];
+                    T1[3][2] = x[1][2] - x[3][2];
+                    T1[3][3] = x[1][3] - x[3][3];
+
+                    T2[0][0] = T1[0][0] - T1[0][2];
+                    T2[0][1] = T1[0][1] + T1[0][2];
+                    T2[0][2] = T1[0][2] - T1[0][1];
+                    T2[0][3] = T1[0][1] - T1[0][3];
+                    T2[1][0] = T1[1][0] - T1[1][2];
+                    T2[1][1] = T1[1][1] + T1[1][2];
+                    T2[1][2] = T1[1][2] - T1[1][1];
+                    T2[1][3] = T1[1][1] - T1[1][3];
+                    T2[2][0] = T1[2][0] - T1[2][2];
+                    T2[2][1] = T1[2][1] + T1[2][2];
+                    T2[2][2] = T1[2][2] - T1[2][1];
+                    T2[2][3] = T1[2][1] - T1[2][3];
+                    T2[3][0] = T1[3][0] - T1[3][2];
+                    T2[3][1] = T1[3][1] + T1[3][2];
+                    T2[3][2] = T1[3][2] - T1[3][1];
+                    T2[3][3] = T1[3][1] - T1[3][3];
+
+                    for (auto i = 0; i < WINOGRAD_ALPHA; i++) {
+                        for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
+                            V[(i*WINOGRAD_ALPHA + j)*C*batch_P + offset] = T2[i][j];
+                        }
                     }
                 }
             }
@@ -525,83 +1029,126 @@ void Network::winograd_transform_in(const std::vector<float>& in,
 void Network::winograd_sgemm(const std::vector<float>& U,
                              std::vector<float>& V,
                              std::vector<float>& M,
-                             const int C, const int K) {
+                             const int C, const int K,
+                             const int batch_size) {
     constexpr auto P = (BOARD_SIZE + 1) * (BOARD_SIZE + 1) / WINOGRAD_ALPHA;
+    const auto batch_P = batch_size * P;
 
     for (auto b = 0; b < WINOGRAD_TILE; b++) {
         auto offset_u = b * K * C;
-        auto offset_v = b * C * P;
-        auto offset_m = b * K * P;
+        auto offset_v = b * C * batch_P;
+        auto offset_m = b * K * batch_P;
 
         cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans,
-                    K, P, C,
+                    K, batch_P, C,
                     1.0f,
                     &U[offset_u], K,
-                    &V[offset_v], P,
+                    &V[offset_v], batch_P,
                     0.0f,
-                    &M[offset_m], P);
+                    &M[offset_m], batch_P);
     }
 }
 
 void Network::winograd_transform_out(const std::vector<float>& M,
                                      std::vector<float>& Y,
-                                     const int K) {
+                                     const int K, const int batch_size,
+                                     const float* bn_means,
+                                     const float* bn_stddivs,
+                                     const float* residual) {
+    using WinogradKernels::Isa;
+    const auto isa = WinogradKernels::get_isa();
+    if (isa == Isa::AVX512 && WinogradKernels::transform_out_avx512(
+            M.data(), Y.data(), K, batch_size,
+            bn_means, bn_stddivs, residual)) {
+        return;
+    }
+    if (isa != Isa::SCALAR && WinogradKernels::transform_out_avx2(
+            M.data(), Y.data(), K, batch_size,
+            bn_means, bn_stddivs, residual)) {
+        return;
+    }
+
     constexpr auto W = BOARD_SIZE;
     constexpr auto H = BOARD_SIZE;
     constexpr auto wtiles = (W + 1) / 2;
     constexpr auto P = wtiles * wtiles;
+    const auto batch_P = batch_size * P;
 
-    for (auto k = 0; k < K; k++) {
-        for (auto block_x = 0; block_x < wtiles; block_x++) {
-            for (auto block_y = 0; block_y < wtiles; block_y++) {
+    // One output plane, still in L1 when the batchnorm is applied.
+    std::array<float, W * H> plane;
 
-                const auto x = 2 * block_x;
-                const auto y = 2 * block_y;
+    for (auto n = 0; n < batch_size; n++) {
+        for (auto k = 0; k < K; k++) {
+            for (auto block_x = 0; block_x < wtiles; block_x++) {
+                for (auto block_y = 0; block_y < wtiles; block_y++) {
+
+                    const auto x = 2 * block_x;
+                    const auto y = 2 * block_y;
+
+                    const auto b = n * P + block_y * wtiles + block_x;
+                    std::array<float, WINOGRAD_TILE> temp_m;
+                    for (auto xi = 0; xi < WINOGRAD_ALPHA; xi++) {
+                        for (auto nu = 0; nu < WINOGRAD_ALPHA; nu++) {
+                            temp_m[xi*WINOGRAD_ALPHA + nu] =
+                                M[xi*(WINOGRAD_ALPHA*K*batch_P) + nu*(K*batch_P)
+                                  + k*batch_P + b];
+                        }
+                    }
 
-                const auto b = block_y * wtiles + block_x;
-                std::array<float, WINOGRAD_TILE> temp_m;
-                for (auto xi = 0; xi < WINOGRAD_ALPHA; xi++) {
-                    for (auto nu = 0; nu < WINOGRAD_ALPHA; nu++) {
-                        temp_m[xi*WINOGRAD_ALPHA + nu] =
-                            M[xi*(WINOGRAD_ALPHA*K*P) + nu*(K*P)+ k*P + b];
+                    // Calculates transpose(A).temp_m.A
+                    //    A = [1.0,  0.0],
+                    //        [1.0,  1.0],
+                    //        [1.0, -1.0],
+                    //        [0.0, -1.0]]
+
+                    auto o11 =
+                        temp_m[0*4 + 0] + temp_m[0*4 + 1] + temp_m[0*4 + 2] +
+                        temp_m[1*4 + 0] + temp_m[1*4 + 1] + temp_m[1*4 + 2] +
+                        temp_m[2*4 + 0] + temp_m[2*4 + 1] + temp_m[2*4 + 2];
+
+                    auto o12 =
+                        temp_m[0*4 + 1] - temp_m[0*4 + 2] - temp_m[0*4 + 3] +
+                        temp_m[1*4 + 1] - temp_m[1*4 + 2] - temp_m[1*4 + 3] +
+                        temp_m[2*4 + 1] - temp_m[2*4 + 2] - temp_m[2*4 + 3];
+
+                    auto o21 =
+                        temp_m[1*4 + 0] + temp_m[1*4 + 1] + temp_m[1*4 + 2] -
+                        temp_m[2*4 + 0] - temp_m[2*4 + 1] - temp_m[2*4 + 2] -
+                        temp_m[3*4 + 0] - temp_m[3*4 + 1] - temp_m[3*4 + 2];
+
+                    auto o22 =
+                        temp_m[1*4 + 1] - temp_m[1*4 + 2] - temp_m[1*4 + 3] -
+                        temp_m[2*4 + 1] + temp_m[2*4 + 2] + temp_m[2*4 + 3] -
+                        temp_m[3*4 + 1] + temp_m[3*4 + 2] + temp_m[3*4 + 3];
+
+                    plane[(y)*W + (x)] = o11;
+                    if (x + 1 < W) {
+                        plane[(y)*W + (x+1)] = o12;
+                    }
+                    if (y + 1 < H) {
+                        plane[(y+1)*W + (x)] = o21;
+                        if (x + 1 < W) {
+                            plane[(y+1)*W + (x+1)] = o22;
+                        }
                     }
                 }
+            }
 
-                // Calculates transpose(A).temp_m.A
-                //    A = [1.0,  0.0],
-                //        [1.0,  1.0],
-                //        [1.0, -1.0],
-                //        [0.0, -1.0]]
-
-                auto o11 =
-                    temp_m[0*4 + 0] + temp_m[0*4 + 1] + temp_m[0*4 + 2] +
-                    temp_m[1*4 + 0] + temp_m[1*4 + 1] + temp_m[1*4 + 2] +
-                    temp_m[2*4 + 0] + temp_m[2*4 + 1] + temp_m[2*4 + 2];
-
-                auto o12 =
-                    temp_m[0*4 + 1] - temp_m[0*4 + 2] - temp_m[0*4 + 3] +
-                    temp_m[1*4 + 1] - temp_m[1*4 + 2] - temp_m[1*4 + 3] +
-                    temp_m[2*4 + 1] - temp_m[2*4 + 2] - temp_m[2*4 + 3];
-
-                auto o21 =
-                    temp_m[1*4 + 0] + temp_m[1*4 + 1] + temp_m[1*4 + 2] -
-                    temp_m[2*4 + 0] - temp_m[2*4 + 1] - temp_m[2*4 + 2] -
-                    temp_m[3*4 + 0] - temp_m[3*4 + 1] - temp_m[3*4 + 2];
-
-                auto o22 =
-                    temp_m[1*4 + 1] - temp_m[1*4 + 2] - temp_m[1*4 + 3] -
-                    temp_m[2*4 + 1] + temp_m[2*4 + 2] + temp_m[2*4 + 3] -
-                    temp_m[3*4 + 1] + temp_m[3*4 + 2] + temp_m[3*4 + 3];
-
-                Y[k*(H*W) + (y)*W + (x)] = o11;
-                if (x + 1 < W) {
-                    Y[k*(H*W) + (y)*W + (x+1)] = o12;
+            // Batchnorm, residual add and ReLU. Kept as a separate loop
+            // over the plane so that it vectorizes.
+            const auto mean = bn_means[k];
+            const auto scale_stddiv = bn_stddivs[k];
+            const auto out = (n*K + k)*(H*W);
+            if (residual) {
+                const auto res = &residual[out];
+                for (auto i = 0; i < W * H; i++) {
+                    auto val = res[i] + scale_stddiv * (plane[i] - mean);
+                    Y[out + i] = (val > 0.0f) ? val : 0.0f;
                 }
-                if (y + 1 < H) {
-                    Y[k*(H*W) + (y+1)*W + (x)] = o21;
-                    if (x + 1 < W) {
-                        Y[k*(H*W) + (y+1)*W + (x+1)] = o22;
-                    }
+            } else {
+                for (auto i = 0; i < W * H; i++) {
+                    auto val = scale_stddiv * (plane[i] - mean);
+                    Y[out + i] = (val > 0.0f) ? val : 0.0f;
                 }
             }
         }
@@ -613,52 +1160,40 @@ void Network::winograd_convolve3(const int outputs,
                                  const std::vector<float>& U,
                                  std::vector<float>& V,
                                  std::vector<float>& M,
-                                 std::vector<float>& output) {
+                                 std::vector<float>& output,
+                                 const int batch_size,
+                                 const std::vector<float>& bn_means,
+                                 const std::vector<float>& bn_stddivs,
+                                 const float* residual) {
 
     constexpr unsigned int filter_len = WINOGRAD_ALPHA * WINOGRAD_ALPHA;
     const auto input_channels = U.size() / (outputs * filter_len);
 
-    winograd_transform_in(input, V, input_channels);
-    winograd_sgemm(U, V, M, input_channels, outputs);
-    winograd_transform_out(M, output, outputs);
+    winograd_transform_in(input, V, input_channels, batch_size);
+    winograd_sgemm(U, V, M, input_channels, outputs, batch_size);
+    winograd_transform_out(M, output, outputs, batch_size,
+                           bn_means.data(), bn_stddivs.data(), residual);
 }
 
-template<unsigned int filter_size>
-void convolve(size_t outputs,
-              const std::vector<net_t>& input,
-              const std::vector<float>& weights,
-              const std::vector<float>& biases,
-              std::vector<float>& output) {
+// 1x1 convolution. With a 1x1 filter the im2col of the input is the
+// input itself, so it goes straight into the SGEMM.
+void convolve1(size_t outputs,
+               const float* input,
+               const std::vector<float>& weights,
+               const std::vector<float>& biases,
+               float* output) {
     // The size of the board is defined at compile time
-    constexpr unsigned int width = BOARD_SIZE;
-    constexpr unsigned int height = BOARD_SIZE;
-    constexpr unsigned int board_squares = width * height;
-    constexpr unsigned int filter_len = filter_size * filter_size;
-    const auto input_channels = weights.size() / (biases.size() * filter_len);
-    const auto filter_dim = filter_len * input_channels;
-    assert(outputs * board_squares == output.size());
-
-    std::vector<float> col(filter_dim * width * height);
-    im2col<filter_size>(input_channels, input, col);
-
-    // Weight shape (output, input, filter_size, filter_size)
-    // 96 18 3 3
-    // C←αAB + βC
-    // outputs[96,19x19] = weights[96,18x3x3] x col[18x3x3,19x19]
-    // M Number of rows in matrices A and C.
-    // N Number of columns in matrices B and C.
-    // K Number of columns in matrix A; number of rows in matrix B.
-    // lda The size of the first dimention of matrix A; if you are
-    // passing a matrix A[m][n], the value should be m.
-    //    cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
-    //                ldb, beta, C, N);
+    constexpr unsigned int board_squares = BOARD_SQUARES;
+    const auto input_channels = weights.size() / biases.size();
 
+    // Weight shape (output, input)
+    // outputs[2,19x19] = weights[2,128] x input[128,19x19]
     cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
                 // M        N            K
-                outputs, board_squares, filter_dim,
-                1.0f, &weights[0], filter_dim,
-                &col[0], board_squares,
-                0.0f, &output[0], board_squares);
+                outputs, board_squares, input_channels,
+                1.0f, &weights[0], input_channels,
+                input, board_squares,
+                0.0f, output, board_squares);
 
     for (unsigned int o = 0; o < outputs; o++) {
         for (unsigned int b = 0; b < board_squares; b++) {
@@ -698,7 +1233,7 @@ void innerproduct(const std::vector<float>& input,
 
 template <size_t spatial_size>
 void batchnorm(size_t channels,
-               std::vector<float>& data,
+               float* data,
                const float* means,
                const float* stddivs,
                const float* eltwise = nullptr)
@@ -728,13 +1263,177 @@ void batchnorm(size_t channels,
     }
 }
 
+void Network::quantize_int8_weights(
+    const std::vector<std::vector<float>>& weights) {
+    int8_convs.clear();
+    int8_convs.resize(weights.size());
+    for (auto i = size_t{1}; i < weights.size(); i++) {
+        const auto& w = weights[i];
+        auto& conv = int8_convs[i];
+        conv.outputs = conv_biases[i].size();
+        conv.channels = w.size() / (9 * conv.outputs);
+
+        // Symmetric, one scale per output channel.
+        const auto filter_size = size_t(9 * conv.channels);
+        auto quantized = std::vector<std::int8_t>(w.size());
+        conv.weight_scales.resize(conv.outputs);
+        for (auto k = 0; k < conv.outputs; k++) {
+            const auto filter = begin(w) + k * filter_size;
+            auto absmax = 0.0f;
+            for (auto j = size_t{0}; j < filter_size; j++) {
+                absmax = std::max(absmax, std::abs(filter[j]));
+            }
+            const auto scale = absmax > 0.0f
+                ? absmax / Int8Kernels::MAX_WEIGHT : 1.0f;
+            conv.weight_scales[k] = scale;
+            for (auto j = size_t{0}; j < filter_size; j++) {
+                quantized[k * filter_size + j] =
+                    static_cast<std::int8_t>(std::lround(filter[j] / scale));
+            }
+        }
+        conv.weights = Int8Kernels::pack_weights(quantized, conv.outputs,
+                                                 conv.channels);
+    }
+}
+
+// Network input for the position itself, without a symmetry.
+static std::vector<float> unrotated_input(const Network::NNPlanes& planes) {
+    auto input = std::vector<float>(planes.size() * BOARD_SQUARES);
+    for (auto c = size_t{0}; c < planes.size(); c++) {
+        for (auto i = 0; i < BOARD_SQUARES; i++) {
+            input[c * BOARD_SQUARES + i] = float(planes[c][i]);
+        }
+    }
+    return input;
+}
+
+void Network::calibrate_int8() {
+    // forward_cpu records the largest input of every tower convolution,
+    // which becomes the top of the 8-bit range.
+    auto maxima = std::vector<float>(int8_convs.size(), 0.0f);
+    int8_calibration = &maxima;
+
+    auto pol = std::vector<float>(OUTPUTS_POLICY * BOARD_SQUARES);
+    auto val = std::vector<float>(OUTPUTS_VALUE * BOARD_SQUARES);
+    auto positions = 0;
+    for (const auto moves : int8_calibration_games) {
+        GameState game;
+        game.init_game(BOARD_SIZE, 7.5f);
+        std::istringstream movestream(moves);
+        std::string vertex;
+        auto ply = 0;
+        while (movestream >> vertex) {
+            const auto color =
+                game.get_to_move() == FastBoard::BLACK ? "b" : "w";
+            if (!game.play_textmove(color, vertex)) {
+                break;
+            }
+            if (++ply % 4 == 0) {
+                const auto state = SearchState(game);
+                NNPlanes planes;
+                gather_features(&state, planes);
+                auto input = unrotated_input(planes);
+                forward_cpu(input, pol, val, FP32);
+                positions++;
+            }
+        }
+    }
+    int8_calibration = nullptr;
+
+    // Other positions go past the calibration maxima, and clipping
+    // those costs more accuracy than the coarser steps of some headroom.
+    constexpr auto headroom = 1.5f;
+    for (auto i = size_t{1}; i < int8_convs.size(); i++) {
+        int8_convs[i].input_scale = maxima[i] > 0.0f
+            ? headroom * maxima[i] / Int8Kernels::MAX_ACTIVATION : 1.0f;
+    }
+    myprintf("Int8 tower: %s, calibrated on %d positions.\n",
+             Int8Kernels::get_isa_name(Int8Kernels::get_isa()), positions);
+}
+
+static void observe_int8_input(size_t index, const std::vector<float>& input) {
+    if (int8_calibration) {
+        auto& maximum = (*int8_calibration)[index];
+        maximum = std::max(maximum,
+                           *std::max_element(begin(input), end(input)));
+    }
+}
+
+// Quantizes the (ReLU, so non-negative) input to the calibrated scale,
+// convolves in 8 bits and scales the 32-bit sums back to floats for the
+// batchnorm, residual add and ReLU. residual may be output itself.
+static void int8_convolve3(const Int8Conv& conv,
+                           const std::vector<float>& input,
+                           std::vector<float>& output,
+                           const int batch_size,
+                           const std::vector<float>& bn_means,
+                           const std::vector<float>& bn_stddivs,
+                           const float* residual = nullptr) {
+    constexpr auto W = BOARD_SIZE;
+    constexpr auto PAD = Int8Kernels::PAD;
+    const auto C = conv.channels;
+    const auto K = conv.outputs;
+    const auto cpad = Int8Kernels::pad_channels(C);
+    const auto Kpad = Int8Kernels::pad_outputs(K);
+
+    // The border and the padding channels are never written, so they
+    // stay zero.
+    auto& act = get_workspace().int8_act;
+    auto& sums = get_workspace().int8_sums;
+    if (act.size() != size_t(PAD * PAD * cpad)) {
+        act.assign(PAD * PAD * cpad, 0);
+    }
+    sums.resize(BOARD_SQUARES * Kpad);
+
+    const auto inv_scale = 1.0f / conv.input_scale;
+    constexpr auto top = float(Int8Kernels::MAX_ACTIVATION);
+    for (auto n = 0; n < batch_size; n++) {
+        const auto in = input.data() + n * C * BOARD_SQUARES;
+        for (auto c = 0; c < C; c++) {
+            for (auto y = 0; y < W; y++) {
+                for (auto x = 0; x < W; x++) {
+                    const auto q = in[(c * W + y) * W + x] * inv_scale + 0.5f;
+                    act[((y + 1) * PAD + x + 1) * cpad + c] =
+                        static_cast<std::uint8_t>(std::min(std::max(q, 0.0f),
+                                                           top));
+                }
+            }
+        }
+
+        Int8Kernels::convolve3(act.data(), conv.weights.data(), C, K,
+                               sums.data());
+
+        const auto out = output.data() + n * K * BOARD_SQUARES;
+        const auto res = residual ? residual + n * K * BOARD_SQUARES
+                                  : nullptr;
+        for (auto k = 0; k < K; k++) {
+            const auto dequant = conv.input_scale * conv.weight_scales[k];
+            const auto mean = bn_means[k];
+            const auto scale = bn_stddivs[k];
+            for (auto p = 0; p < BOARD_SQUARES; p++) {
+                auto v = scale * (sums[p * Kpad + k] * dequant - mean);
+                if (res) {
+                    v += res[k * BOARD_SQUARES + p];
+                }
+                out[k * BOARD_SQUARES + p] = std::max(v, 0.0f);
+            }
+        }
+    }
+}
+
 void Network::forward_cpu(std::vector<float>& input,
                           std::vector<float>& output_pol,
-                          std::vector<float>& output_val) {
+                          std::vector<float>& output_val,
+                          Precision precision) {
     // Input convolution
     constexpr int width = BOARD_SIZE;
     constexpr int height = BOARD_SIZE;
     constexpr int tiles = (width + 1) * (height + 1) / 4;
+    // The input can hold several positions back to back, which
+    // are then evaluated together with one SGEMM per tile element.
+    const auto batch_size =
+        static_cast<int>(input.size() / (INPUT_CHANNELS * width * height));
+    assert(batch_size >= 1);
     // Calculate output channels
     const auto output_channels = conv_biases[0].size();
     //input_channels is the maximum number of input channels of any convolution.
@@ -743,40 +1442,65 @@ void Network::forward_cpu(std::vector<float>& input,
     const auto input_channels = std::max(
             static_cast<size_t>(output_channels),
             static_cast<size_t>(INPUT_CHANNELS));
-    auto conv_out = std::vector<float>(output_channels * width * height);
-
-    auto V = std::vector<float>(WINOGRAD_TILE * input_channels * tiles);
-    auto M = std::vector<float>(WINOGRAD_TILE * output_channels * tiles);
-
-    winograd_convolve3(output_channels, input, conv_weights[0], V, M, conv_out);
-    batchnorm<BOARD_SQUARES>(output_channels, conv_out,
-                             batchnorm_means[0].data(),
-                             batchnorm_stddivs[0].data());
+    const auto conv_size = output_channels * width * height;
+    auto& workspace = get_workspace();
+    auto& conv_out = workspace.conv_out;
+    auto& conv_in = workspace.conv_in;
+    auto& V = workspace.V;
+    auto& M = workspace.M;
+    conv_out.resize(batch_size * conv_size);
+    conv_in.resize(batch_size * conv_size);
+    V.resize(WINOGRAD_TILE * input_channels * tiles * batch_size);
+    M.resize(WINOGRAD_TILE * output_channels * tiles * batch_size);
+
+    // Batchnorm and ReLU are fused into the output transforms.
+    winograd_convolve3(output_channels, input, conv_weights[0], V, M, conv_out,
+                       batch_size, batchnorm_means[0], batchnorm_stddivs[0]);
 
     // Residual tower
-    auto conv_in = std::vector<float>(output_channels * width * height);
-    auto res = std::vector<float>(output_channels * width * height);
+    const auto int8 = (precision == INT8);
+    assert(!int8 || !int8_convs.empty());
     for (auto i = size_t{1}; i < conv_weights.size(); i += 2) {
         auto output_channels = conv_biases[i].size();
         std::swap(conv_out, conv_in);
-        std::copy(begin(conv_in), end(conv_in), begin(res));
-        winograd_convolve3(output_channels, conv_in,
-	                       conv_weights[i], V, M, conv_out);
-        batchnorm<BOARD_SQUARES>(output_channels, conv_out,
-                                 batchnorm_means[i].data(),
-                                 batchnorm_stddivs[i].data());
+        observe_int8_input(i, conv_in);
+        if (int8) {
+            int8_convolve3(int8_convs[i], conv_in, conv_out, batch_size,
+                           batchnorm_means[i], batchnorm_stddivs[i]);
+        } else {
+            winograd_convolve3(output_channels, conv_in,
+                               conv_weights[i], V, M, conv_out, batch_size,
+                               batchnorm_means[i], batchnorm_stddivs[i]);
+        }
 
+        // conv_out still holds the block input after the swap. Each
+        // output reads only its own residual before overwriting it, so
+        // the residual add can be done in place.
         output_channels = conv_biases[i + 1].size();
         std::swap(conv_out, conv_in);
-        winograd_convolve3(output_channels, conv_in,
-			               conv_weights[i + 1], V, M, conv_out);
-        batchnorm<BOARD_SQUARES>(output_channels, conv_out,
-                                 batchnorm_means[i + 1].data(),
-                                 batchnorm_stddivs[i + 1].data(),
-                                 res.data());
-    }
-    convolve<1>(OUTPUTS_POLICY, conv_out, conv_pol_w, conv_pol_b, output_pol);
-    convolve<1>(OUTPUTS_VALUE, conv_out, conv_val_w, conv_val_b, output_val);
+        observe_int8_input(i + 1, conv_in);
+        if (int8) {
+            int8_convolve3(int8_convs[i + 1], conv_in, conv_out, batch_size,
+                           batchnorm_means[i + 1], batchnorm_stddivs[i + 1],
+                           conv_out.data());
+        } else {
+            winograd_convolve3(output_channels, conv_in,
+                               conv_weights[i + 1], V, M, conv_out,
+                               batch_size, batchnorm_means[i + 1],
+                               batchnorm_stddivs[i + 1], conv_out.data());
+        }
+    }
+
+    // The 1x1 head convolutions are cheap, run them position by position.
+    constexpr auto pol_size = OUTPUTS_POLICY * width * height;
+    constexpr auto val_size = OUTPUTS_VALUE * width * height;
+    for (auto n = 0; n < batch_size; n++) {
+        const auto head_in = conv_out.data() + n * conv_size;
+        convolve1(OUTPUTS_POLICY, head_in, conv_pol_w, conv_pol_b,
+                  output_pol.data() + n * pol_size);
+        convolve1(OUTPUTS_VALUE, head_in, conv_val_w, conv_val_b,
+                  output_val.data() + n * val_size);
+    }
 }
 
 template<typename T>
@@ -832,107 +1556,110 @@ void Network::softmax(const std::vector<float>& input,
     alpha /= temperature;
 
     auto denom = 0.0f;
-    auto helper = std::vector<float>(output.size());
     for (auto i = size_t{0}; i < output.size(); i++) {
         auto val   = std::exp((input[i]/temperature) - alpha);
-        helper[i]  = val;
+        output[i]  = val;
         denom     += val;
     }
     for (auto i = size_t{0}; i < output.size(); i++) {
-        output[i] = helper[i] / denom;
+        output[i] /= denom;
     }
 }
 
 Network::Netresult Network::get_scored_moves(
-    const GameState* state, Ensemble ensemble, int rotation, bool skip_cache) {
+    const SearchState* state, Ensemble ensemble, int rotation, bool skip_cache) {
     Netresult result;
     if (state->board.get_boardsize() != BOARD_SIZE) {
         return result;
     }
 
-    // See if we already have this in the cache.
+    // See if we already have this in the cache, or a symmetric position.
+    auto symmetry = 0;
+    const auto key = NNCache::get_key(*state, 0, &symmetry);
     if (!skip_cache) {
-      if (NNCache::get_NNCache().lookup(state->board.get_hash(), result)) {
+      if (NNCache::get_NNCache().lookup(key, symmetry, result)) {
         return result;
       }
     }
 
-    NNPlanes planes;
+    auto& planes = get_workspace().planes;
     gather_features(state, planes);
 
     if (ensemble == DIRECT) {
         assert(rotation >= 0 && rotation <= 7);
-        result = get_scored_moves_internal(state, planes, rotation);
+        result = get_scored_moves_internal(state, planes, rotation,
+                                           tower_precision);
+    } else if (ensemble == AVERAGE) {
+        assert(rotation == -1);
+        result = get_scored_moves_average(state, planes);
     } else {
         assert(ensemble == RANDOM_ROTATION);
         assert(rotation == -1);
         auto rand_rot = Random::get_Rng().randfix<8>();
-        result = get_scored_moves_internal(state, planes, rand_rot);
+        result = get_scored_moves_internal(state, planes, rand_rot,
+                                           tower_precision);
     }
 
     // Insert result into cache.
-    NNCache::get_NNCache().insert(state->board.get_hash(), result);
+    NNCache::get_NNCache().insert(key, symmetry, result);
 
     return result;
 }
 
-Network::Netresult Network::get_scored_moves_internal(
-    const GameState* state, NNPlanes & planes, int rotation) {
+void Network::rotate_input(const NNPlanes& planes, int rotation,
+                           float* input_data) {
     assert(rotation >= 0 && rotation <= 7);
     assert(INPUT_CHANNELS == planes.size());
     constexpr int width = BOARD_SIZE;
     constexpr int height = BOARD_SIZE;
-    const auto convolve_channels = conv_pol_w.size() / conv_pol_b.size();
-    std::vector<net_t> input_data;
-    std::vector<net_t> output_data(convolve_channels * width * height);
-    std::vector<float> policy_data(OUTPUTS_POLICY * width * height);
-    std::vector<float> value_data(OUTPUTS_VALUE * width * height);
-    std::vector<float> policy_out((width * height) + 1);
-    std::vector<float> softmax_data((width * height) + 1);
-    std::vector<float> winrate_data(256);
-    std::vector<float> winrate_out(1);
     // Data layout is input_data[(c * height + h) * width + w]
-    input_data.reserve(INPUT_CHANNELS * width * height);
+    auto idx = size_t{0};
     for (int c = 0; c < INPUT_CHANNELS; ++c) {
         for (int h = 0; h < height; ++h) {
             for (int w = 0; w < width; ++w) {
                 auto rot_idx = rotate_nn_idx_table[rotation][h * BOARD_SIZE + w];
-                input_data.emplace_back(net_t(planes[c][rot_idx]));
+                input_data[idx++] = net_t(planes[c][rot_idx]);
             }
         }
     }
-#ifdef USE_OPENCL
-    opencl.forward(input_data, policy_data, value_data);
-#elif defined(USE_BLAS) && !defined(USE_OPENCL)
-    forward_cpu(input_data, policy_data, value_data);
-#endif
-#ifdef USE_OPENCL_SELFCHECK
-    // Both implementations are available, self-check the OpenCL driver by
-    // running both with a probability of 1/2000.
-    if (Random::get_Rng().randfix<SELFCHECK_PROBABILITY>() == 0) {
-        auto cpu_policy_data = std::vector<float>(policy_data.size());
-        auto cpu_value_data = std::vector<float>(value_data.size());
-        forward_cpu(input_data, cpu_policy_data, cpu_value_data);
-        compare_net_outputs(policy_data, cpu_policy_data);
-        compare_net_outputs(value_data, cpu_value_data);
-    }
-#endif
+}
+
+float Network::evaluate_heads() {
+    auto& workspace = get_workspace();
+    auto& policy_data = workspace.policy_data;
+    auto& value_data = workspace.value_data;
+    auto& policy_out = workspace.policy_out;
+    auto& winrate_data = workspace.winrate_data;
+    auto& winrate_out = workspace.winrate_out;
 
     // Get the moves
-    batchnorm<BOARD_SQUARES>(OUTPUTS_POLICY, policy_data, bn_pol_w1.data(), bn_pol_w2.data());
+    batchnorm<BOARD_SQUARES>(OUTPUTS_POLICY, policy_data.data(), bn_pol_w1.data(), bn_pol_w2.data());
     innerproduct<OUTPUTS_POLICY * BOARD_SQUARES, BOARD_SQUARES + 1>(policy_data, ip_pol_w, ip_pol_b, policy_out);
-    softmax(policy_out, softmax_data, cfg_softmax_temp);
-    std::vector<float>& outputs = softmax_data;
+    softmax(policy_out, workspace.softmax_data, cfg_softmax_temp);
 
     // Now get the score
-    batchnorm<BOARD_SQUARES>(OUTPUTS_VALUE, value_data, bn_val_w1.data(), bn_val_w2.data());
+    batchnorm<BOARD_SQUARES>(OUTPUTS_VALUE, value_data.data(), bn_val_w1.data(), bn_val_w2.data());
     innerproduct<BOARD_SQUARES, 256>(value_data, ip1_val_w, ip1_val_b, winrate_data);
     innerproduct<256, 1>(winrate_data, ip2_val_w, ip2_val_b, winrate_out);
 
     // Sigmoid
-    auto winrate_sig = (1.0f + std::tanh(winrate_out[0])) / 2.0f;
+    return (1.0f + std::tanh(winrate_out[0])) / 2.0f;
+}
 
+Network::Netresult Network::make_result(const SearchState* state,
+                                        const std::vector<float>& outputs,
+                                        int rotation, float winrate) {
+    // Sized up front, the result is the one allocation left.
+    auto moves = size_t{1};
+    for (auto y = 0; y < BOARD_SIZE; y++) {
+        for (auto x = 0; x < BOARD_SIZE; x++) {
+            if (state->board.get_square(x, y) == FastBoard::EMPTY) {
+                moves++;
+            }
+        }
+    }
     std::vector<scored_node> result;
+    result.reserve(moves);
     for (auto idx = size_t{0}; idx < outputs.size(); idx++) {
         if (idx < BOARD_SQUARES) {
             auto val = outputs[idx];
@@ -948,7 +1675,177 @@ Network::Netresult Network::get_scored_moves_internal(
         }
     }
 
-    return std::make_pair(result, winrate_sig);
+    return std::make_pair(std::move(result), winrate);
+}
+
+Network::Netresult Network::get_scored_moves_internal(
+    const SearchState* state, NNPlanes & planes, int rotation,
+    Precision precision) {
+    auto& workspace = get_workspace();
+    auto& input_data = workspace.input_data;
+    auto& policy_data = workspace.policy_data;
+    auto& value_data = workspace.value_data;
+    rotate_input(planes, rotation, input_data.data());
+#ifdef USE_OPENCL
+    // The OpenCL tower only runs in fp32.
+    (void)precision;
+    opencl.forward(input_data, policy_data, value_data);
+#elif defined(USE_BLAS) && !defined(USE_OPENCL)
+    // Batches run at the precision of the search, anything else is
+    // evaluated on its own.
+    if (precision == tower_precision) {
+        batch_scheduler.forward(input_data, policy_data, value_data);
+    } else {
+        forward_cpu(input_data, policy_data, value_data, precision);
+    }
+#endif
+#ifdef USE_OPENCL_SELFCHECK
+    // Both implementations are available, self-check the OpenCL driver by
+    // running both with a probability of 1/2000.
+    if (Random::get_Rng().randfix<SELFCHECK_PROBABILITY>() == 0) {
+        auto cpu_policy_data = std::vector<float>(policy_data.size());
+        auto cpu_value_data = std::vector<float>(value_data.size());
+        forward_cpu(input_data, cpu_policy_data, cpu_value_data, FP32);
+        compare_net_outputs(policy_data, cpu_policy_data);
+        compare_net_outputs(value_data, cpu_value_data);
+    }
+#endif
+
+    auto winrate = evaluate_heads();
+    return make_result(state, workspace.softmax_data, rotation, winrate);
+}
+
+Network::Netresult Network::get_scored_moves_average(
+    const SearchState* state, NNPlanes & planes) {
+    constexpr auto symmetries = NUM_SYMMETRIES;
+    constexpr auto input_size = INPUT_CHANNELS * BOARD_SQUARES;
+    constexpr auto pol_size = OUTPUTS_POLICY * BOARD_SQUARES;
+    constexpr auto val_size = OUTPUTS_VALUE * BOARD_SQUARES;
+    auto& workspace = get_workspace();
+    auto& input = workspace.ensemble_input;
+    auto& policy = workspace.ensemble_policy;
+    auto& value = workspace.ensemble_value;
+    input.resize(symmetries * input_size);
+    policy.resize(symmetries * pol_size);
+    value.resize(symmetries * val_size);
+    for (auto r = 0; r < symmetries; r++) {
+        rotate_input(planes, r, input.data() + r * input_size);
+    }
+#ifdef USE_OPENCL
+    // The OpenCL forward runs one position at a time.
+    for (auto r = 0; r < symmetries; r++) {
+        std::copy_n(begin(input) + r * input_size, input_size,
+                    begin(workspace.input_data));
+        opencl.forward(workspace.input_data,
+                       workspace.policy_data, workspace.value_data);
+        std::copy(begin(workspace.policy_data), end(workspace.policy_data),
+                  begin(policy) + r * pol_size);
+        std::copy(begin(workspace.value_data), end(workspace.value_data),
+                  begin(value) + r * val_size);
+    }
+#else
+    // All symmetries go through the tower as one batch.
+    forward_cpu(input, policy, value, tower_precision);
+#endif
+
+    // Undo the rotation of each policy before averaging it.
+    auto& average = workspace.ensemble_outputs;
+    average.assign(BOARD_SQUARES + 1, 0.0f);
+    auto winrate = 0.0f;
+    for (auto r = 0; r < symmetries; r++) {
+        std::copy_n(begin(policy) + r * pol_size, pol_size,
+                    begin(workspace.policy_data));
+        std::copy_n(begin(value) + r * val_size, val_size,
+                    begin(workspace.value_data));
+        winrate += evaluate_heads();
+        const auto& outputs = workspace.softmax_data;
+        for (auto idx = size_t{0}; idx < BOARD_SQUARES; idx++) {
+            average[rotate_nn_idx_table[r][idx]] += outputs[idx];
+        }
+        average[BOARD_SQUARES] += outputs[BOARD_SQUARES];
+    }
+    for (auto& val : average) {
+        val /= symmetries;
+    }
+
+    return make_result(state, average, 0, winrate / symmetries);
+}
+
+static int best_move(const Network::Netresult& result) {
+    return std::max_element(begin(result.first), end(result.first))->second;
+}
+
+std::string Network::int8_accuracy(int positions) {
+    if (int8_convs.empty()) {
+        return {};
+    }
+
+    // Positions from random games, with a fixed seed so that runs can be
+    // compared. They are unrelated to the calibration positions.
+    auto rng = Random(5489);
+    auto agree = 0;
+    auto squared_error = 0.0;
+    auto max_error = 0.0f;
+    auto inputs = std::vector<std::vector<float>>{};
+    for (auto i = 0; i < positions; i++) {
+        GameState game;
+        game.init_game(BOARD_SIZE, 7.5f);
+        const auto moves = rng.randuint64(250);
+        for (auto m = size_t{0}; m < moves; m++) {
+            auto vertex = int{FastBoard::PASS};
+            for (auto tries = 0; tries < 20; tries++) {
+                const auto x = int(rng.randuint64(BOARD_SIZE));
+                const auto y = int(rng.randuint64(BOARD_SIZE));
+                const auto candidate = game.board.get_vertex(x, y);
+                if (game.is_move_legal(game.get_to_move(), candidate)) {
+                    vertex = candidate;
+                    break;
+                }
+            }
+            game.play_move(vertex);
+        }
+
+        const auto state = SearchState(game);
+        NNPlanes planes;
+        gather_features(&state, planes);
+        const auto reference =
+            get_scored_moves_internal(&state, planes, 0, FP32);
+        const auto quantized =
+            get_scored_moves_internal(&state, planes, 0, INT8);
+
+        if (best_move(reference) == best_move(quantized)) {
+            agree++;
+        }
+        const auto error = quantized.second - reference.second;
+        squared_error += error * error;
+        max_error = std::max(max_error, std::abs(error));
+        inputs.emplace_back(unrotated_input(planes));
+    }
+
+    // Throughput straight through forward_cpu, so that waiting for
+    // batches to fill up doesn't count.
+    auto pol = std::vector<float>(OUTPUTS_POLICY * BOARD_SQUARES);
+    auto val = std::vector<float>(OUTPUTS_VALUE * BOARD_SQUARES);
+    auto evals_per_second = [&](Precision precision) {
+        Time start;
+        for (auto& input : inputs) {
+            forward_cpu(input, pol, val, precision);
+        }
+        Time end;
+        return inputs.size() / std::max(Time::timediff_seconds(start, end),
+                                        0.001);
+    };
+    const auto fp32_speed = evals_per_second(FP32);
+    const auto int8_speed = evals_per_second(INT8);
+
+    return boost::str(boost::format(
+        "%d positions, int8 tower %s\n"
+        "policy top-1 agreement %.1f%%\n"
+        "value MSE %.6f, max error %.4f\n"
+        "fp32 %.0f n/s, int8 %.0f n/s")
+        % positions % Int8Kernels::get_isa_name(Int8Kernels::get_isa())
+        % (100.0 * agree / positions) % (squared_error / positions)
+        % max_error % fp32_speed % int8_speed);
 }
 
 void Network::show_heatmap(const FastState * state, Netresult& result, bool topmoves) {
@@ -1004,27 +1901,14 @@ void Network::show_heatmap(const FastState * state, Netresult& result, bool topm
     }
 }
 
-void Network::fill_input_plane_pair(const FullBoard& board,
-                                    BoardPlane& black, BoardPlane& white) {
-    auto idx = 0;
-    for (int j = 0; j < BOARD_SIZE; j++) {
-        for(int i = 0; i < BOARD_SIZE; i++) {
-            int vtx = board.get_vertex(i, j);
-            auto color = board.get_square(vtx);
-            if (color != FastBoard::EMPTY) {
-                if (color == FastBoard::BLACK) {
-                    black[idx] = true;
-                } else {
-                    white[idx] = true;
-                }
-            }
-            idx++;
-        }
-    }
-}
-
-void Network::gather_features(const GameState* state, NNPlanes & planes) {
+void Network::gather_features(const SearchState* state, NNPlanes & planes) {
+    static_assert(SearchState::HISTORY_BOARDS >= INPUT_MOVES,
+                  "SearchState must keep enough boards for the input");
     planes.resize(INPUT_CHANNELS);
+    // The planes can be reused from an earlier position.
+    for (auto& plane : planes) {
+        plane.reset();
+    }
     BoardPlane& black_to_move = planes[2 * INPUT_MOVES];
     BoardPlane& white_to_move = planes[2 * INPUT_MOVES + 1];
 
@@ -1044,9 +1928,9 @@ void Network::gather_features(const GameState* state, NNPlanes & planes) {
     // Go back in time, fill history boards
     for (auto h = size_t{0}; h < moves; h++) {
         // collect white, black occupation planes
-        fill_input_plane_pair(state->get_past_board(h),
-                              planes[black_offset + h],
-                              planes[white_offset + h]);
+        const auto& past = state->get_past_board(h);
+        planes[black_offset + h] = past.black;
+        planes[white_offset + h] = past.white;
     }
 }
 
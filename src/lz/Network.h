@@ -31,24 +31,35 @@
 
 #include "FastState.h"
 #include "GameState.h"
+#include "SearchState.h"
 
 class Network {
 public:
+    // AVERAGE evaluates all 8 symmetries in one batch and averages them.
     enum Ensemble {
-        DIRECT, RANDOM_ROTATION
+        DIRECT, RANDOM_ROTATION, AVERAGE
+    };
+    // Arithmetic of the residual tower, INT8 needs --int8.
+    enum Precision {
+        FP32, INT8
     };
     using BoardPlane = std::bitset<BOARD_SQUARES>;
     using NNPlanes = std::vector<BoardPlane>;
     using scored_node = std::pair<float, int>;
     using Netresult = std::pair<std::vector<scored_node>, float>;
 
-    static Netresult get_scored_moves(const GameState* state,
+    static Netresult get_scored_moves(const SearchState* state,
                                       Ensemble ensemble,
                                       int rotation = -1,
                                       bool skip_cache = false);
     // File format version
     static constexpr auto FORMAT_VERSION = 1;
+    // Version of the binary format, which has the weights Winograd
+    // transformed and the biases folded in, ready to use.
+    static constexpr auto BINARY_VERSION = 1;
     static constexpr auto INPUT_MOVES = 8;
+    // Rotations and reflections of the board, see Ensemble::AVERAGE.
+    static constexpr auto NUM_SYMMETRIES = 8;
     static constexpr auto INPUT_CHANNELS = 2 * INPUT_MOVES + 2;
     static constexpr auto OUTPUTS_POLICY = 2;
     static constexpr auto OUTPUTS_VALUE = 1;
@@ -58,17 +69,45 @@ public:
     static constexpr auto WINOGRAD_TILE = WINOGRAD_ALPHA * WINOGRAD_ALPHA;
 
     static void initialize();
-    static void benchmark(const GameState * state, int iterations = 1600);
+    // Also counts the heap allocations per evaluation in builds with
+    // COUNT_ALLOCATIONS.
+    static std::string benchmark(const GameState * state,
+                                 int iterations = 1600);
     static void show_heatmap(const FastState * state, Netresult & netres,
                              bool topmoves);
     static void softmax(const std::vector<float>& input,
                         std::vector<float>& output,
                         float temperature = 1.0f);
 
-    static void gather_features(const GameState* state, NNPlanes& planes);
+    static void gather_features(const SearchState* state, NNPlanes& planes);
+    // Index (y * BOARD_SIZE + x) that vertex maps to under one of the 8
+    // board symmetries, 0 being the identity.
+    static int rotate_nn_idx(const int vertex, int symmetry);
+
+    // Compares the int8 residual tower (--int8) with the fp32 one on
+    // positions from random games. Returns an empty string when the
+    // int8 tower is not in use.
+    static std::string int8_accuracy(int positions);
+
+    // Writes the v1 text network in text_file to binary_file in the
+    // binary format.
+    static bool convert_weights(const std::string& text_file,
+                                const std::string& binary_file);
+    // Channels and residual blocks of a weights file, of either format,
+    // reading only the start of it. Blocks is 0 for text files.
+    static std::pair<int, int> peek_weights_file(const std::string& filename);
+    // Hash of the loaded network, 0 before initialize.
+    static std::uint64_t get_weights_hash();
 private:
     static std::pair<int, int> load_v1_network(std::ifstream& wtfile);
     static std::pair<int, int> load_network_file(std::string filename);
+    static std::pair<int, int> load_binary_network(const std::string& filename);
+    static bool write_binary_network(
+        const std::string& filename, size_t channels, size_t residual_blocks,
+        std::vector<std::vector<float>>& raw_weights);
+    // Winograd transforms the 3x3 filters and folds the biases into the
+    // batchnorm means, as stored by the binary format.
+    static void prepare_weights(size_t channels, size_t residual_blocks);
     static void process_bn_var(std::vector<float>& weights,
                                const float epsilon=1e-5f);
 
@@ -79,28 +118,50 @@ private:
         const int outputs_pad, const int channels_pad);
     static void winograd_transform_in(const std::vector<float>& in,
                                       std::vector<float>& V,
-                                      const int C);
+                                      const int C, const int batch_size);
+    // Also applies the batchnorm, the residual add (when residual is
+    // not null, it may be Y itself) and the ReLU, while the tile is
+    // still in registers.
     static void winograd_transform_out(const std::vector<float>& M,
                                        std::vector<float>& Y,
-                                       const int K);
+                                       const int K, const int batch_size,
+                                       const float* bn_means,
+                                       const float* bn_stddivs,
+                                       const float* residual);
     static void winograd_convolve3(const int outputs,
                                    const std::vector<float>& input,
                                    const std::vector<float>& U,
                                    std::vector<float>& V,
                                    std::vector<float>& M,
-                                   std::vector<float>& output);
+                                   std::vector<float>& output,
+                                   const int batch_size,
+                                   const std::vector<float>& bn_means,
+                                   const std::vector<float>& bn_stddivs,
+                                   const float* residual = nullptr);
     static void winograd_sgemm(const std::vector<float>& U,
                                std::vector<float>& V,
-                               std::vector<float>& M, const int C, const int K);
-    static int rotate_nn_idx(const int vertex, int symmetry);
-    static void fill_input_plane_pair(
-      const FullBoard& board, BoardPlane& black, BoardPlane& white);
+                               std::vector<float>& M, const int C, const int K,
+                               const int batch_size);
     static Netresult get_scored_moves_internal(
-      const GameState* state, NNPlanes & planes, int rotation);
+      const SearchState* state, NNPlanes & planes, int rotation,
+      Precision precision);
+    static Netresult get_scored_moves_average(
+      const SearchState* state, NNPlanes & planes);
+    static void rotate_input(const NNPlanes& planes, int rotation,
+                             float* input_data);
+    static float evaluate_heads();
+    static Netresult make_result(const SearchState* state,
+                                 const std::vector<float>& outputs,
+                                 int rotation, float winrate);
 #if defined(USE_BLAS)
     static void forward_cpu(std::vector<float>& input,
                             std::vector<float>& output_pol,
-                            std::vector<float>& output_val);
+                            std::vector<float>& output_val,
+                            Precision precision);
+    // Takes the 3x3 weights before their Winograd transform.
+    static void quantize_int8_weights(
+        const std::vector<std::vector<float>>& weights);
+    static void calibrate_int8();
 
 #endif
 };
@@ -0,0 +1,59 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "SearchState.h"
+
+#include <algorithm>
+#include <cassert>
+
+SearchState::SearchState(const GameState& root)
+    : FastState(root), m_root(&root) {
+}
+
+void SearchState::play_move(int vertex) {
+    FastState::play_move(vertex);
+
+    m_plies++;
+    m_history[m_plies % HISTORY_BOARDS] = PastBoard(board);
+    m_ko_hashes[m_plies % KO_HISTORY] = board.get_ko_hash();
+}
+
+bool SearchState::superko() const {
+    if (m_plies == 0) {
+        return m_root->superko();
+    }
+
+    const auto ko_hash = board.get_ko_hash();
+    const auto oldest = std::max(1, m_plies - KO_HISTORY + 1);
+    for (auto ply = m_plies - 1; ply >= oldest; ply--) {
+        if (m_ko_hashes[ply % KO_HISTORY] == ko_hash) {
+            return true;
+        }
+    }
+    return m_root->in_ko_history(ko_hash);
+}
+
+const PastBoard& SearchState::get_past_board(int moves_ago) const {
+    assert(moves_ago >= 0 && (unsigned)moves_ago <= m_movenum);
+    if (moves_ago >= m_plies) {
+        return m_root->get_past_board(moves_ago - m_plies);
+    }
+    assert(moves_ago < HISTORY_BOARDS);
+    return m_history[(m_plies - moves_ago) % HISTORY_BOARDS];
+}
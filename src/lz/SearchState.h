@@ -0,0 +1,62 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEARCHSTATE_H_INCLUDED
+#define SEARCHSTATE_H_INCLUDED
+
+#include "config.h"
+
+#include <array>
+#include <cstdint>
+
+#include "FastState.h"
+#include "FullBoard.h"
+#include "GameState.h"
+
+/*
+    State used by a single playout. It copies only the board from the
+    root GameState and keeps what the network needs of the positions
+    played since then in fixed size rings, so a playout does no heap
+    allocation, no large copies and touches no shared reference counts.
+    Anything older than the rings comes from the root, which must stay
+    unchanged while the playout runs.
+*/
+class SearchState : public FastState {
+public:
+    // Past positions kept for the network input, the current one included.
+    static constexpr auto HISTORY_BOARDS = 8;
+    // Positions since the root checked for superko.
+    static constexpr auto KO_HISTORY = 256;
+
+    explicit SearchState(const GameState& root);
+
+    void play_move(int vertex);
+    bool superko() const;
+    const PastBoard& get_past_board(int moves_ago) const;
+
+private:
+    const GameState* m_root;
+    // Moves played since the root.
+    int m_plies{0};
+    // Position after ply p is stored at index p % HISTORY_BOARDS.
+    std::array<PastBoard, HISTORY_BOARDS> m_history;
+    // Ko hash after ply p is stored at index p % KO_HISTORY.
+    std::array<std::uint64_t, KO_HISTORY> m_ko_hashes;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "TTable.h"
+
+#include <cstring>
+
+#include "UCTNode.h"
+#include "Utils.h"
+
+TTable& TTable::get_TT() {
+    static TTable tt;
+    return tt;
+}
+
+TTable::TTable(int size) : m_buckets(size) {
+}
+
+std::uint64_t TTable::get_key(const FastState& state) {
+    auto komi = state.get_komi() + state.get_handicap();
+    auto komi_bits = std::uint32_t{0};
+    std::memcpy(&komi_bits, &komi, sizeof(komi_bits));
+    return state.board.get_hash()
+           ^ (std::uint64_t{komi_bits} * 0x9E3779B97F4A7C15ULL);
+}
+
+static std::size_t children_bytes(
+    const std::vector<Network::scored_node>& children) {
+    return sizeof(children)
+           + children.capacity() * sizeof(Network::scored_node);
+}
+
+void TTable::release_children(TTEntry& bucket) {
+    if (bucket.m_children) {
+        m_children_bytes -= children_bytes(*bucket.m_children);
+        bucket.m_children.reset();
+    }
+}
+
+void TTable::new_search() {
+    const auto generation = ++m_generation;
+    // Entries from the previous search still help the tree it left, the
+    // older ones are from positions the game has moved past.
+    for (auto idx = size_t{0}; idx < m_buckets.size(); idx++) {
+        LOCK(m_locks[idx % NUM_LOCKS], lock);
+        auto& bucket = m_buckets[idx];
+        if (bucket.m_generation < generation - 1) {
+            release_children(bucket);
+        }
+    }
+}
+
+void TTable::drop_children() {
+    for (auto idx = size_t{0}; idx < m_buckets.size(); idx++) {
+        LOCK(m_locks[idx % NUM_LOCKS], lock);
+        release_children(m_buckets[idx]);
+    }
+}
+
+std::size_t TTable::get_children_memory() const {
+    return m_children_bytes;
+}
+
+bool TTable::claim(TTEntry& bucket, std::uint64_t key, int visits) {
+    const auto generation = m_generation.load();
+    if (bucket.m_hash != key) {
+        // Keep the more searched position, unless it is left over
+        // from an earlier search.
+        if (bucket.m_generation == generation && bucket.m_visits > visits) {
+            return false;
+        }
+        release_children(bucket);
+        bucket = TTEntry{};
+        bucket.m_hash = key;
+    }
+    bucket.m_generation = generation;
+    return true;
+}
+
+bool TTable::lookup(std::uint64_t key, TTEntry& entry) {
+    const auto idx = key % m_buckets.size();
+    LOCK(m_locks[idx % NUM_LOCKS], lock);
+    ++m_lookups;
+
+    const auto& bucket = m_buckets[idx];
+    if (bucket.m_hash != key) {
+        return false;
+    }
+    entry = bucket;
+    if (entry.m_children) {
+        ++m_shared_expansions;
+    }
+    return true;
+}
+
+void TTable::store_expansion(std::uint64_t key, float net_eval,
+                             const std::vector<Network::scored_node>& children) {
+    // Build the copy outside the lock.
+    auto shared = std::make_shared<const std::vector<Network::scored_node>>(
+        children);
+
+    const auto idx = key % m_buckets.size();
+    LOCK(m_locks[idx % NUM_LOCKS], lock);
+
+    auto& bucket = m_buckets[idx];
+    // The node being expanded is about to get its first visit.
+    if (!claim(bucket, key, 1)) {
+        return;
+    }
+    release_children(bucket);
+    m_children_bytes += children_bytes(*shared);
+    bucket.m_net_eval = net_eval;
+    bucket.m_children = std::move(shared);
+}
+
+void TTable::update(std::uint64_t key, const UCTNode* node) {
+    const auto visits = node->get_visits();
+
+    const auto idx = key % m_buckets.size();
+    LOCK(m_locks[idx % NUM_LOCKS], lock);
+
+    auto& bucket = m_buckets[idx];
+    if (!claim(bucket, key, visits)) {
+        return;
+    }
+    // Only decides which position keeps the bucket.
+    if (visits > bucket.m_visits) {
+        bucket.m_visits = visits;
+    }
+}
+
+void TTable::dump_stats() {
+    Utils::myprintf("TT: %d/%d expansions shared/lookups, %.1f MiB\n",
+                    m_shared_expansions.load(), m_lookups.load(),
+                    get_children_memory() / 1048576.0);
+}
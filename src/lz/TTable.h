@@ -0,0 +1,102 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TTABLE_H_INCLUDED
+#define TTABLE_H_INCLUDED
+
+#include "config.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FastState.h"
+#include "Network.h"
+#include "SMP.h"
+
+class UCTNode;
+
+class TTEntry {
+public:
+    std::uint64_t m_hash{0};
+    // Search that last touched this entry.
+    int m_generation{0};
+    // Visits of the most visited node seen for this position.
+    int m_visits{0};
+    // Expansion shared by all transpositions: the net eval (black's
+    // point of view) and the legal, normalized move priors.
+    float m_net_eval{0.0f};
+    std::shared_ptr<const std::vector<Network::scored_node>> m_children;
+};
+
+/*
+    Optional transposition table, enabled with --transpositions. The tree
+    stays a tree: every node keeps its own children and counters, so
+    nothing here points into it and pruning or freeing subtrees is not
+    affected. A node reaching a position that was already expanded
+    elsewhere copies that expansion instead of running the network, and
+    backs up the net eval stored with it, exactly what the network would
+    have returned. Visit counts and subtree results are never copied, so
+    nothing gets counted twice and the visit limits stay consistent.
+
+    The shared expansions are counted in the tree memory budget. Pruning
+    the tree drops them first, and a new search drops those from before
+    the previous one, so the table doesn't hold on to old games.
+*/
+class TTable {
+public:
+    static TTable& get_TT();
+
+    // Key for the position: board hash (stones, ko, side to move,
+    // passes and prisoners) mixed with the komi.
+    static std::uint64_t get_key(const FastState& state);
+
+    bool lookup(std::uint64_t key, TTEntry& entry);
+    void store_expansion(std::uint64_t key, float net_eval,
+                         const std::vector<Network::scored_node>& children);
+    void update(std::uint64_t key, const UCTNode* node);
+    // Entries from earlier searches can be replaced by any new position.
+    void new_search();
+    // Frees all shared expansions, the table is only a cache.
+    void drop_children();
+    // Bytes held by the shared expansions.
+    std::size_t get_children_memory() const;
+
+    void dump_stats();
+
+private:
+    TTable(int size = 100'000);
+    bool claim(TTEntry& bucket, std::uint64_t key, int visits);
+    void release_children(TTEntry& bucket);
+
+    static constexpr auto NUM_LOCKS = 256;
+
+    std::vector<TTEntry> m_buckets;
+    std::array<SMP::Mutex, NUM_LOCKS> m_locks;
+    std::atomic<int> m_generation{0};
+    std::atomic<std::size_t> m_children_bytes{0};
+
+    // Statistics
+    std::atomic<int> m_shared_expansions{0};
+    std::atomic<int> m_lookups{0};
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "TreeReclaimer.h"
+
+#include <utility>
+
+TreeReclaimer tree_reclaimer;
+
+TreeReclaimer::~TreeReclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void TreeReclaimer::discard(UCTNode::node_ptr_t tree) {
+    if (!tree) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.emplace_back(std::move(tree));
+        // Started on first use, so nothing runs during static init.
+        if (!m_thread.joinable()) {
+            m_thread = std::thread(&TreeReclaimer::worker, this);
+        }
+    }
+    m_cv.notify_one();
+}
+
+void TreeReclaimer::wait_idle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cv.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+}
+
+size_t TreeReclaimer::get_backlog() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size() + (m_busy ? 1 : 0);
+}
+
+void TreeReclaimer::worker() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_exit || !m_queue.empty(); });
+        // Drain the queue even when exiting, so that nothing leaks.
+        if (m_queue.empty()) {
+            return;
+        }
+        auto tree = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_busy = true;
+        lock.unlock();
+
+        tree.reset();
+
+        lock.lock();
+        m_busy = false;
+        if (m_queue.empty()) {
+            m_idle_cv.notify_all();
+        }
+    }
+}
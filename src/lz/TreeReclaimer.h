@@ -0,0 +1,62 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TREERECLAIMER_H_INCLUDED
+#define TREERECLAIMER_H_INCLUDED
+
+#include "config.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "UCTNode.h"
+
+/*
+    Frees discarded search trees on a background thread. When the root
+    advances, the siblings of the new root can be millions of nodes, and
+    tearing them down on the search thread would delay the next genmove.
+*/
+class TreeReclaimer {
+public:
+    ~TreeReclaimer();
+
+    void discard(UCTNode::node_ptr_t tree);
+    // Blocks until all discarded trees have been freed.
+    void wait_idle();
+    // Number of discarded trees not yet freed.
+    size_t get_backlog();
+
+private:
+    void worker();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_idle_cv;
+    std::deque<UCTNode::node_ptr_t> m_queue;
+    // Set while the worker is freeing a tree.
+    bool m_busy{false};
+    bool m_exit{false};
+    std::thread m_thread;
+};
+
+extern TreeReclaimer tree_reclaimer;
+
+#endif
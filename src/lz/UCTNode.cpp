@@ -36,13 +36,29 @@
 #include "GTP.h"
 #include "GameState.h"
 #include "Network.h"
+#include "TTable.h"
+#include "UCTNodePool.h"
 #include "Utils.h"
 
 using namespace Utils;
 
+static std::atomic<size_t> s_children_memory{0};
+
 UCTNode::UCTNode(int vertex, float score) : m_move(vertex), m_score(score) {
 }
 
+UCTNode::~UCTNode() {
+    s_children_memory -= m_children.capacity() * sizeof(UCTNodePointer);
+}
+
+void* UCTNode::operator new(std::size_t size) {
+    return UCTNodePool::allocate(size);
+}
+
+void UCTNode::operator delete(void* ptr) noexcept {
+    UCTNodePool::deallocate(ptr);
+}
+
 bool UCTNode::first_visit() const {
     return m_visits == 0;
 }
@@ -54,7 +70,7 @@ SMP::Mutex& UCTNode::get_mutex() {
 bool IsWastefulEscape(const FastState& state, int color, int v);
 
 bool UCTNode::create_children(std::atomic<int>& nodecount,
-                              GameState& state,
+                              SearchState& state,
                               float& eval) {
     // check whether somebody beat us to it (atomic)
     if (has_children()) {
@@ -78,8 +94,25 @@ bool UCTNode::create_children(std::atomic<int>& nodecount,
     m_is_expanding = true;
     lock.unlock();
 
+    auto tt_key = std::uint64_t{0};
+    if (cfg_transpositions) {
+        tt_key = TTable::get_key(state);
+        auto entry = TTEntry{};
+        if (TTable::get_TT().lookup(tt_key, entry) && entry.m_children) {
+            // The same sample the network would give. A transposition's
+            // subtree mean could be this node's own results from before
+            // its children were pruned, and count them again.
+            m_net_eval = entry.m_net_eval;
+            eval = m_net_eval;
+            auto nodelist = *entry.m_children;
+            link_nodelist(nodecount, nodelist);
+            return true;
+        }
+    }
+
     auto raw_netlist = Network::get_scored_moves(
-        &state, Network::Ensemble::RANDOM_ROTATION);
+        &state, cfg_average_symmetries ? Network::Ensemble::AVERAGE
+                                       : Network::Ensemble::RANDOM_ROTATION);
 
     // DCNN returns winrate as side to move
     m_net_eval = raw_netlist.second;
@@ -90,10 +123,13 @@ bool UCTNode::create_children(std::atomic<int>& nodecount,
     }
     eval = m_net_eval;
 
-    std::vector<Network::scored_node> nodelist;
+    // The illegal moves are dropped in place, the cache decodes straight
+    // into this list.
+    auto nodelist = std::move(raw_netlist.first);
 
     auto legal_sum = 0.0f;
-    for (auto& node : raw_netlist.first) {
+    auto legal_moves = size_t{0};
+    for (auto& node : nodelist) {
         auto vertex = node.second;
         if (state.is_move_legal(to_move, vertex)) {
 
@@ -101,10 +137,11 @@ bool UCTNode::create_children(std::atomic<int>& nodecount,
             if (IsWastefulEscape(state, to_move, vertex))
                 node.first *= 0.001;
 
-            nodelist.emplace_back(node);
+            nodelist[legal_moves++] = node;
             legal_sum += node.first;
         }
     }
+    nodelist.resize(legal_moves);
 
     if (legal_sum > std::numeric_limits<float>::min()) {
         // re-normalize after removing illegal moves.
@@ -119,6 +156,10 @@ bool UCTNode::create_children(std::atomic<int>& nodecount,
         }
     }
 
+    if (cfg_transpositions) {
+        TTable::get_TT().store_expansion(tt_key, m_net_eval, nodelist);
+    }
+
     link_nodelist(nodecount, nodelist);
     return true;
 }
@@ -136,16 +177,32 @@ void UCTNode::link_nodelist(std::atomic<int>& nodecount,
 
     m_children.reserve(nodelist.size());
     for (const auto& node : nodelist) {
-        m_children.emplace_back(
-            std::make_unique<UCTNode>(node.second, node.first)
-        );
+        m_children.emplace_back(node.second, node.first);
     }
 
+    s_children_memory += m_children.capacity() * sizeof(UCTNodePointer);
     nodecount += m_children.size();
-    m_has_children = true;
+    m_subtree_nodes += m_children.size();
+    // Publish the children: uct_select_child reads them without the lock.
+    m_has_children.store(true, std::memory_order_release);
 }
 
-const std::vector<UCTNode::node_ptr_t>& UCTNode::get_children() const {
+size_t UCTNode::clear_children() {
+    auto removed = count_nodes();
+    s_children_memory -= m_children.capacity() * sizeof(UCTNodePointer);
+    std::vector<UCTNodePointer>().swap(m_children);
+    m_subtree_nodes = 0;
+    m_has_children = false;
+    // Allow the node to be expanded again when it is next visited.
+    m_is_expanding = false;
+    return removed;
+}
+
+size_t UCTNode::get_children_memory() {
+    return s_children_memory;
+}
+
+const std::vector<UCTNodePointer>& UCTNode::get_children() const {
     return m_children;
 }
 
@@ -168,7 +225,7 @@ void UCTNode::update(float eval) {
 }
 
 bool UCTNode::has_children() const {
-    return m_has_children;
+    return m_has_children.load(std::memory_order_acquire);
 }
 
 float UCTNode::get_score() const {
@@ -180,14 +237,14 @@ void UCTNode::set_score(float score) {
 }
 
 int UCTNode::get_visits() const {
-    return m_visits;
+    return m_visits.load(std::memory_order_relaxed);
 }
 
 float UCTNode::get_eval(int tomove) const {
     // Due to the use of atomic updates and virtual losses, it is
     // possible for the visit count to change underneath us. Make sure
     // to return a consistent result to the caller by caching the values.
-    auto virtual_loss = int{m_virtual_loss};
+    auto virtual_loss = int{m_virtual_loss.load(std::memory_order_relaxed)};
     auto visits = get_visits() + virtual_loss;
     assert(visits > 0);
     auto blackeval = get_blackevals();
@@ -209,7 +266,7 @@ float UCTNode::get_net_eval(int tomove) const {
 }
 
 double UCTNode::get_blackevals() const {
-    return m_blackevals;
+    return m_blackevals.load(std::memory_order_relaxed);
 }
 
 void UCTNode::accumulate_eval(float eval) {
@@ -217,19 +274,22 @@ void UCTNode::accumulate_eval(float eval) {
 }
 
 UCTNode* UCTNode::uct_select_child(int color) {
-    UCTNode* best = nullptr;
+    UCTNodePointer* best = nullptr;
     auto best_value = -1000.0;
 
-    LOCK(get_mutex(), lock);
+    // No lock: the children were published before has_children() became
+    // true and don't change during the search. Visits and evals may move
+    // under us, which only makes the scores slightly stale, and virtual
+    // losses keep the threads spread out.
 
     // Count parentvisits manually to avoid issues with transpositions.
     auto total_visited_policy = 0.0f;
     auto parentvisits = size_t{0};
     for (const auto& child : m_children) {
-        if (child->valid()) {
-            parentvisits += child->get_visits();
-            if (child->get_visits() > 0) {
-                total_visited_policy += child->get_score();
+        if (child.valid()) {
+            parentvisits += child.get_visits();
+            if (child.get_visits() > 0) {
+                total_visited_policy += child.get_score();
             }
         }
     }
@@ -239,49 +299,55 @@ UCTNode* UCTNode::uct_select_child(int color) {
     // Estimated eval for unknown nodes = original parent NN eval - reduction
     auto fpu_eval = get_net_eval(color) - fpu_reduction;
 
-    for (const auto& child : m_children) {
-        if (!child->active()) {
+    for (auto& child : m_children) {
+        if (!child.active()) {
             continue;
         }
 
         float winrate = fpu_eval;
-        if (child->get_visits() > 0) {
-            winrate = child->get_eval(color);
+        if (child.get_visits() > 0) {
+            winrate = child.get_eval(color);
         }
-        auto psa = child->get_score();
-        auto denom = 1.0 + child->get_visits();
+        auto psa = child.get_score();
+        auto denom = 1.0 + child.get_visits();
         auto puct = cfg_puct * psa * (numerator / denom);
         auto value = winrate + puct;
         assert(value > -1000.0);
 
         if (value > best_value) {
             best_value = value;
-            best = child.get();
+            best = &child;
         }
     }
 
     assert(best != nullptr);
-    return best;
+    // The chosen child is about to be visited, so it needs a real node.
+    return best->get();
 }
 
-class NodeComp : public std::binary_function<UCTNode::node_ptr_t&,
-                                             UCTNode::node_ptr_t&, bool> {
+class NodeComp : public std::binary_function<UCTNodePointer&,
+                                             UCTNodePointer&, bool> {
 public:
     NodeComp(int color) : m_color(color) {};
-    bool operator()(const UCTNode::node_ptr_t& a,
-                    const UCTNode::node_ptr_t& b) {
+    bool operator()(const UCTNodePointer& a,
+                    const UCTNodePointer& b) {
+        // Read the visits once, other threads may be updating them.
+        // A child with visits is always inflated.
+        auto a_visits = a.get_visits();
+        auto b_visits = b.get_visits();
+
         // if visits are not same, sort on visits
-        if (a->get_visits() != b->get_visits()) {
-            return a->get_visits() < b->get_visits();
+        if (a_visits != b_visits) {
+            return a_visits < b_visits;
         }
 
         // neither has visits, sort on prior score
-        if (a->get_visits() == 0) {
-            return a->get_score() < b->get_score();
+        if (a_visits == 0) {
+            return a.get_score() < b.get_score();
         }
 
         // both have same non-zero number of visits
-        return a->get_eval(m_color) < b->get_eval(m_color);
+        return a.get_eval(m_color) < b.get_eval(m_color);
     }
 private:
     int m_color;
@@ -292,23 +358,40 @@ void UCTNode::sort_children(int color) {
     std::stable_sort(rbegin(m_children), rend(m_children), NodeComp(color));
 }
 
-UCTNode& UCTNode::get_best_root_child(int color) {
-    LOCK(get_mutex(), lock);
+const UCTNodePointer& UCTNode::get_best_root_child(int color) const {
+    // The children are only reordered once the search has stopped,
+    // and comparing them never inflates an edge.
     assert(!m_children.empty());
 
-    return *(std::max_element(begin(m_children), end(m_children),
-                              NodeComp(color))->get());
+    return *std::max_element(begin(m_children), end(m_children),
+                             NodeComp(color));
 }
 
-size_t UCTNode::count_nodes() const {
-    auto nodecount = size_t{0};
-    if (m_has_children) {
-        nodecount += m_children.size();
-        for (auto& child : m_children) {
-            nodecount += child->count_nodes();
+size_t UCTNode::prune_subtrees(int min_visits) {
+    auto removed = size_t{0};
+    for (const auto& child : m_children) {
+        if (!child.is_inflated()) {
+            continue;
+        }
+        auto node = child.get();
+        if (node->get_visits() < min_visits) {
+            // Keep the node and its stats, it gets re-expanded
+            // if the search comes back to it.
+            removed += node->clear_children();
+        } else {
+            removed += node->prune_subtrees(min_visits);
         }
     }
-    return nodecount;
+    m_subtree_nodes -= static_cast<int>(removed);
+    return removed;
+}
+
+size_t UCTNode::count_nodes() const {
+    return m_subtree_nodes;
+}
+
+void UCTNode::add_subtree_nodes(int nodes) {
+    m_subtree_nodes += nodes;
 }
 
 void UCTNode::invalidate() {
@@ -322,9 +405,9 @@ void UCTNode::set_active(const bool active) {
 }
 
 bool UCTNode::valid() const {
-    return m_status != INVALID;
+    return m_status.load(std::memory_order_relaxed) != INVALID;
 }
 
 bool UCTNode::active() const {
-    return m_status == ACTIVE;
+    return m_status.load(std::memory_order_relaxed) == ACTIVE;
 }
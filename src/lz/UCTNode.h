@@ -22,12 +22,15 @@
 #include "config.h"
 
 #include <atomic>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
 #include "GameState.h"
 #include "Network.h"
 #include "SMP.h"
+#include "SearchState.h"
+#include "UCTNodePointer.h"
 
 class UCTNode {
 public:
@@ -41,17 +44,30 @@ public:
     // Defined in UCTNode.cpp
     explicit UCTNode(int vertex, float score);
     UCTNode() = delete;
-    ~UCTNode() = default;
+    ~UCTNode();
+
+    // Nodes are allocated from UCTNodePool.
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr) noexcept;
 
     bool create_children(std::atomic<int>& nodecount,
-                         GameState& state, float& eval);
+                         SearchState& state, float& eval);
 
-    const std::vector<node_ptr_t>& get_children() const;
+    const std::vector<UCTNodePointer>& get_children() const;
     void sort_children(int color);
-    UCTNode& get_best_root_child(int color);
+    // Drops the subtrees below children with fewer than min_visits.
+    // Returns the number of nodes removed.
+    size_t prune_subtrees(int min_visits);
+    // Lock free, can be used while the search is running.
+    const UCTNodePointer& get_best_root_child(int color) const;
     UCTNode* uct_select_child(int color);
 
+    // Nodes in the subtree below this one, kept up to date as the
+    // tree grows, so this is O(1).
     size_t count_nodes() const;
+    void add_subtree_nodes(int nodes);
+    // Bytes held by the child lists of all nodes.
+    static size_t get_children_memory();
     SMP::Mutex& get_mutex();
     bool first_visit() const;
     bool has_children() const;
@@ -74,6 +90,7 @@ public:
     // Defined in UCTNodeRoot.cpp, only to be called on m_root in UCTSearch
     void kill_superkos(const KoState& state);
 
+    void inflate_all_children();
     UCTNode* get_first_child() const;
     UCTNode* get_nopass_child(FastState& state) const;
     node_ptr_t find_child(const int move);
@@ -86,6 +103,7 @@ private:
     };
     void link_nodelist(std::atomic<int>& nodecount,
                        std::vector<Network::scored_node>& nodelist);
+    size_t clear_children();
 
     // Note : This class is very size-sensitive as we are going to create
     // tens of millions of instances of these.  Please put extra caution
@@ -109,7 +127,8 @@ private:
 
     // Tree data
     std::atomic<bool> m_has_children{false};
-    std::vector<node_ptr_t> m_children;
+    std::atomic<int> m_subtree_nodes{0};
+    std::vector<UCTNodePointer> m_children;
 };
 
 #endif
@@ -0,0 +1,137 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "UCTNodePointer.h"
+#include "UCTNode.h"
+
+static_assert(sizeof(UCTNodePointer) == sizeof(std::uint64_t),
+              "UCTNodePointer must stay a single word");
+
+UCTNodePointer::UCTNodePointer(std::int16_t vertex, float score)
+    : m_data(pack(vertex, score)) {
+}
+
+UCTNodePointer::~UCTNodePointer() {
+    auto v = m_data.load(std::memory_order_acquire);
+    if (!is_edge(v)) {
+        delete read_ptr(v);
+    }
+}
+
+UCTNodePointer::UCTNodePointer(UCTNodePointer&& n)
+    : m_data(n.m_data.exchange(EDGE_TAG)) {
+}
+
+UCTNodePointer& UCTNodePointer::operator=(UCTNodePointer&& n) {
+    auto v = m_data.exchange(n.m_data.exchange(EDGE_TAG));
+    if (!is_edge(v)) {
+        delete read_ptr(v);
+    }
+    return *this;
+}
+
+std::uint64_t UCTNodePointer::pack(std::int16_t vertex, float score) {
+    auto score_bits = std::uint32_t{0};
+    std::memcpy(&score_bits, &score, sizeof(score_bits));
+    auto vertex_bits = static_cast<std::uint16_t>(vertex);
+    return (std::uint64_t{score_bits} << 32)
+           | (std::uint64_t{vertex_bits} << 16)
+           | EDGE_TAG;
+}
+
+std::int16_t UCTNodePointer::read_vertex(std::uint64_t v) {
+    return static_cast<std::int16_t>(static_cast<std::uint16_t>(v >> 16));
+}
+
+float UCTNodePointer::read_score(std::uint64_t v) {
+    auto score_bits = static_cast<std::uint32_t>(v >> 32);
+    auto score = 0.0f;
+    std::memcpy(&score, &score_bits, sizeof(score));
+    return score;
+}
+
+UCTNode* UCTNodePointer::get() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    while (is_edge(v)) {
+        auto node = new UCTNode(read_vertex(v), read_score(v));
+        auto ptr = static_cast<std::uint64_t>(
+            reinterpret_cast<std::uintptr_t>(node));
+        assert(!is_edge(ptr));
+        // Release publishes the constructed node to lock-free readers.
+        if (m_data.compare_exchange_strong(v, ptr,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+            return node;
+        }
+        // Another thread inflated it first, v now holds its pointer.
+        delete node;
+    }
+    return read_ptr(v);
+}
+
+UCTNode* UCTNodePointer::release() {
+    auto node = get();
+    m_data = pack(node->get_move(), node->get_score());
+    return node;
+}
+
+bool UCTNodePointer::valid() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    return is_edge(v) || read_ptr(v)->valid();
+}
+
+bool UCTNodePointer::active() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    return is_edge(v) || read_ptr(v)->active();
+}
+
+int UCTNodePointer::get_move() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    if (is_edge(v)) {
+        return read_vertex(v);
+    }
+    return read_ptr(v)->get_move();
+}
+
+int UCTNodePointer::get_visits() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    if (is_edge(v)) {
+        return 0;
+    }
+    return read_ptr(v)->get_visits();
+}
+
+float UCTNodePointer::get_score() const {
+    auto v = m_data.load(std::memory_order_acquire);
+    if (is_edge(v)) {
+        return read_score(v);
+    }
+    return read_ptr(v)->get_score();
+}
+
+float UCTNodePointer::get_eval(int tomove) const {
+    // Only nodes that have been visited have an eval.
+    auto v = m_data.load(std::memory_order_acquire);
+    assert(!is_edge(v));
+    return read_ptr(v)->get_eval(tomove);
+}
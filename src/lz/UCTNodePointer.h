@@ -0,0 +1,82 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UCTNODEPOINTER_H_INCLUDED
+#define UCTNODEPOINTER_H_INCLUDED
+
+#include "config.h"
+
+#include <atomic>
+#include <cstdint>
+
+class UCTNode;
+
+/*
+    A child link of a UCTNode. Until the child is visited for the first
+    time, it is only a compact edge holding the move and its prior, packed
+    into a single 64-bit word. The first call to get() turns the edge into
+    a real UCTNode and stores the pointer in the same word instead.
+
+    Storage: if bit 0 is set, bits 16-31 hold the move and bits 32-63 the
+    prior. Otherwise the word is a pointer to the inflated node, which is
+    always at least 8-byte aligned.
+*/
+class UCTNodePointer {
+public:
+    UCTNodePointer(std::int16_t vertex, float score);
+    ~UCTNodePointer();
+
+    UCTNodePointer(UCTNodePointer&& n);
+    UCTNodePointer& operator=(UCTNodePointer&& n);
+    UCTNodePointer(const UCTNodePointer&) = delete;
+    UCTNodePointer& operator=(const UCTNodePointer&) = delete;
+
+    bool is_inflated() const {
+        return !is_edge(m_data.load(std::memory_order_acquire));
+    }
+
+    // Inflates the edge if needed. Safe to call from several threads.
+    UCTNode* get() const;
+    // Gives up ownership of the (inflated) node.
+    UCTNode* release();
+
+    // These only read the edge and never inflate it.
+    bool valid() const;
+    bool active() const;
+    int get_move() const;
+    int get_visits() const;
+    float get_score() const;
+    float get_eval(int tomove) const;
+
+private:
+    static constexpr std::uint64_t EDGE_TAG = 1;
+
+    static bool is_edge(std::uint64_t v) {
+        return (v & EDGE_TAG) != 0;
+    }
+    static UCTNode* read_ptr(std::uint64_t v) {
+        return reinterpret_cast<UCTNode*>(static_cast<std::uintptr_t>(v));
+    }
+    static std::uint64_t pack(std::int16_t vertex, float score);
+    static std::int16_t read_vertex(std::uint64_t v);
+    static float read_score(std::uint64_t v);
+
+    mutable std::atomic<std::uint64_t> m_data;
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "UCTNodePool.h"
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "UCTNode.h"
+
+namespace {
+
+struct FreeSlot {
+    FreeSlot* next;
+};
+
+constexpr auto SLOT_ALIGN = alignof(UCTNode) > alignof(FreeSlot)
+                          ? alignof(UCTNode) : alignof(FreeSlot);
+constexpr auto SLOT_SIZE = (sizeof(UCTNode) + SLOT_ALIGN - 1)
+                         / SLOT_ALIGN * SLOT_ALIGN;
+constexpr auto SLAB_SIZE = std::size_t{1} << 20;
+// Free slots move between a thread and the shared list this many at a time.
+constexpr auto TRANSFER_BATCH = std::size_t{1024};
+
+static_assert(SLOT_SIZE >= sizeof(FreeSlot), "Slot too small");
+
+struct SharedPool {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> slabs;
+    std::vector<std::pair<FreeSlot*, std::size_t>> free_lists;
+};
+
+SharedPool& shared_pool() {
+    // Never destroyed: pool threads hand back their slots when they
+    // exit, which can happen during static destruction.
+    static auto pool = new SharedPool;
+    return *pool;
+}
+
+class ThreadCache {
+public:
+    ~ThreadCache() {
+        // Give back the untouched part of the current slab as well.
+        while (m_bump != m_bump_end) {
+            push(reinterpret_cast<FreeSlot*>(m_bump));
+            m_bump += SLOT_SIZE;
+        }
+        if (m_free_count > 0) {
+            auto& pool = shared_pool();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free_lists.emplace_back(m_free, m_free_count);
+        }
+    }
+
+    void* allocate() {
+        if (m_free == nullptr && m_bump == m_bump_end) {
+            refill();
+        }
+        if (m_free != nullptr) {
+            auto slot = m_free;
+            m_free = slot->next;
+            m_free_count--;
+            return slot;
+        }
+        auto slot = m_bump;
+        m_bump += SLOT_SIZE;
+        return slot;
+    }
+
+    void deallocate(void* ptr) {
+        push(static_cast<FreeSlot*>(ptr));
+        if (m_free_count >= 2 * TRANSFER_BATCH) {
+            release_batch();
+        }
+    }
+
+private:
+    void push(FreeSlot* slot) {
+        slot->next = m_free;
+        m_free = slot;
+        m_free_count++;
+    }
+
+    void refill() {
+        auto& pool = shared_pool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (!pool.free_lists.empty()) {
+            std::tie(m_free, m_free_count) = pool.free_lists.back();
+            pool.free_lists.pop_back();
+            return;
+        }
+        pool.slabs.emplace_back(new char[SLAB_SIZE]);
+        m_bump = pool.slabs.back().get();
+        m_bump_end = m_bump + (SLAB_SIZE / SLOT_SIZE) * SLOT_SIZE;
+    }
+
+    void release_batch() {
+        auto head = m_free;
+        auto tail = head;
+        for (auto i = std::size_t{1}; i < TRANSFER_BATCH; i++) {
+            tail = tail->next;
+        }
+        m_free = tail->next;
+        m_free_count -= TRANSFER_BATCH;
+        tail->next = nullptr;
+
+        auto& pool = shared_pool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.free_lists.emplace_back(head, TRANSFER_BATCH);
+    }
+
+    FreeSlot* m_free{nullptr};
+    std::size_t m_free_count{0};
+    char* m_bump{nullptr};
+    char* m_bump_end{nullptr};
+};
+
+thread_local ThreadCache thread_cache;
+
+std::atomic<std::size_t> used_slots{0};
+
+}
+
+void* UCTNodePool::allocate(std::size_t size) {
+    assert(size <= SLOT_SIZE);
+    (void)size;
+    used_slots.fetch_add(1, std::memory_order_relaxed);
+    return thread_cache.allocate();
+}
+
+void UCTNodePool::deallocate(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        used_slots.fetch_sub(1, std::memory_order_relaxed);
+        thread_cache.deallocate(ptr);
+    }
+}
+
+std::size_t UCTNodePool::get_reserved_bytes() {
+    auto& pool = shared_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.slabs.size() * SLAB_SIZE;
+}
+
+std::size_t UCTNodePool::get_used_bytes() {
+    return used_slots.load(std::memory_order_relaxed) * SLOT_SIZE;
+}
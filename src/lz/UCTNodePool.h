@@ -0,0 +1,44 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UCTNODEPOOL_H_INCLUDED
+#define UCTNODEPOOL_H_INCLUDED
+
+#include "config.h"
+
+#include <cstddef>
+
+/*
+    Slab allocator for UCTNode objects. Every thread carves nodes out of
+    large slabs and keeps its own list of free slots, so nodes inflated
+    by one thread end up back to back without touching malloc or any
+    shared lock. Free slots only go through a shared list, in batches,
+    when a thread has collected more than it needs.
+*/
+class UCTNodePool {
+public:
+    static void* allocate(std::size_t size);
+    static void deallocate(void* ptr) noexcept;
+
+    // Memory taken by all slabs, in bytes.
+    static std::size_t get_reserved_bytes();
+    // Memory taken by live nodes, in bytes.
+    static std::size_t get_used_bytes();
+};
+
+#endif
@@ -47,25 +47,35 @@ UCTNode* UCTNode::get_first_child() const {
 }
 
 void UCTNode::kill_superkos(const KoState& state) {
-    for (auto& child : m_children) {
-        auto move = child->get_move();
-        if (move != FastBoard::PASS) {
-            KoState mystate = state;
-            mystate.play_move(move);
-
-            if (mystate.superko()) {
-                // Don't delete nodes for now, just mark them invalid.
-                child->invalidate();
-            }
-        }
-    }
-
-    // Now do the actual deletion.
+    // Edges have no status to mark, so drop the superko moves directly.
+    auto removed = 0;
     m_children.erase(
         std::remove_if(begin(m_children), end(m_children),
-                       [](const auto &child) { return !child->valid(); }),
+                       [&state, &removed](const auto &child) {
+                           auto move = child.get_move();
+                           if (move == FastBoard::PASS) {
+                               return false;
+                           }
+                           KoState mystate = state;
+                           mystate.play_move(move);
+                           if (!mystate.superko()) {
+                               return false;
+                           }
+                           removed += 1;
+                           if (child.is_inflated()) {
+                               removed += child.get()->count_nodes();
+                           }
+                           return true;
+                       }),
         end(m_children)
     );
+    m_subtree_nodes -= removed;
+}
+
+void UCTNode::inflate_all_children() {
+    for (const auto& child : m_children) {
+        child.get();
+    }
 }
 
 UCTNode* UCTNode::get_nopass_child(FastState& state) const {
@@ -74,8 +84,9 @@ UCTNode* UCTNode::get_nopass_child(FastState& state) const {
            we only have unreasonable moves to pick, like filling eyes.
            Note that this knowledge isn't required by the engine,
            we require it because we're overruling its moves. */
-        if (child->m_move != FastBoard::PASS
-            && !state.board.is_eye(state.get_to_move(), child->m_move)) {
+        auto move = child.get_move();
+        if (move != FastBoard::PASS
+            && !state.board.is_eye(state.get_to_move(), move)) {
             return child.get();
         }
     }
@@ -86,8 +97,9 @@ UCTNode* UCTNode::get_nopass_child(FastState& state) const {
 UCTNode::node_ptr_t UCTNode::find_child(const int move) {
     if (m_has_children) {
         for (auto& child : m_children) {
-            if (child->get_move() == move) {
-                return std::move(child);
+            if (child.get_move() == move) {
+                // An unvisited child is inflated here as a fresh node.
+                return node_ptr_t(child.release());
             }
         }
     }
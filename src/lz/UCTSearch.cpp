@@ -19,21 +19,31 @@
 #include "config.h"
 #include "UCTSearch.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdio>
 #include <limits>
 #include <memory>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <vector>
 
+#include "BatchScheduler.h"
 #include "FastBoard.h"
 #include "FastState.h"
 #include "FullBoard.h"
 #include "GTP.h"
 #include "GameState.h"
+#include "NNCache.h"
 #include "ThreadPool.h"
 #include "TimeControl.h"
 #include "Timing.h"
+#include "TTable.h"
+#include "TreeReclaimer.h"
+#include "UCTNodePool.h"
 #include "Utils.h"
 
 using namespace Utils;
@@ -76,7 +86,10 @@ bool UCTSearch::advance_to_new_rootstate() {
     for (auto i = 0; i < depth; i++) {
         test->forward_move();
         const auto move = test->get_last_move();
-        m_root = m_root->find_child(move);
+        auto next = m_root->find_child(move);
+        // The siblings of the new root are freed in the background.
+        tree_reclaimer.discard(std::move(m_root));
+        m_root = std::move(next);
         if (!m_root) {
             // Tree hasn't been expanded this far
             return false;
@@ -98,18 +111,22 @@ void UCTSearch::update_root() {
     // Definition of m_playouts is playouts per search call.
     // So reset this count now.
     m_playouts = 0;
+    if (cfg_transpositions) {
+        TTable::get_TT().new_search();
+    }
 
 #ifndef NDEBUG
     auto start_nodes = m_root->count_nodes();
 #endif
 
     if (!advance_to_new_rootstate() || !m_root) {
+        tree_reclaimer.discard(std::move(m_root));
         m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
     }
     // Clear last_rootstate to prevent accidental use.
     m_last_rootstate.reset(nullptr);
 
-    // Check how big our search tree (reused or new) is.
+    // Subtree sizes are kept up to date, so this doesn't need a walk.
     m_nodes = m_root->count_nodes();
 
 #ifndef NDEBUG
@@ -120,9 +137,10 @@ void UCTSearch::update_root() {
 #endif
 }
 
-SearchResult UCTSearch::play_simulation(GameState & currstate,
+SearchResult UCTSearch::play_simulation(SearchState & currstate,
                                         UCTNode* const node) {
     const auto color = currstate.get_to_move();
+    const auto tt_key = cfg_transpositions ? TTable::get_key(currstate) : 0;
     auto result = SearchResult{};
 
     node->virtual_loss();
@@ -131,11 +149,12 @@ SearchResult UCTSearch::play_simulation(GameState & currstate,
         if (currstate.get_passes() >= 2) {
             auto score = currstate.final_score();
             result = SearchResult::from_score(score);
-        } else if (m_nodes < MAX_TREE_SIZE) {
+        } else if (!tree_memory_full()) {
             float eval;
             auto success = node->create_children(m_nodes, currstate, eval);
             if (success) {
-                result = SearchResult::from_eval(eval);
+                result = SearchResult::from_eval(
+                    eval, static_cast<int>(node->get_children().size()));
             }
         }
     }
@@ -151,12 +170,17 @@ SearchResult UCTSearch::play_simulation(GameState & currstate,
                 next->invalidate();
             } else {
                 result = play_simulation(currstate, next);
+                // Keep the subtree sizes along the path up to date.
+                node->add_subtree_nodes(result.new_nodes());
             }
         }
     }
 
     if (result.valid()) {
         node->update(result.eval());
+        if (cfg_transpositions) {
+            TTable::get_TT().update(tt_key, node);
+        }
     }
     node->virtual_loss_undo();
 
@@ -178,11 +202,12 @@ void UCTSearch::dump_stats(FastState & state, UCTNode & parent) {
     }
 
     int movecount = 0;
-    for (const auto& node : parent.get_children()) {
+    for (const auto& child : parent.get_children()) {
         // Always display at least two moves. In the case there is
         // only one move searched the user could get an idea why.
-        if (++movecount > 2 && !node->get_visits()) break;
+        if (++movecount > 2 && !child.get_visits()) break;
 
+        auto node = child.get();
         std::string move = state.move_to_text(node->get_move());
         FastState tmpstate = state;
         tmpstate.play_move(node->get_move());
@@ -208,11 +233,18 @@ void tree_stats_helper(const UCTNode& node, size_t depth,
     if (depth > max_depth) max_depth = depth;
 
     for (const auto& child : node.get_children()) {
-        if (!child->first_visit()) children_count += 1;
-
-        tree_stats_helper(*(child.get()), depth+1,
-                          nodes, non_leaf_nodes, depth_sum,
-                          max_depth, children_count);
+        if (child.get_visits() > 0) children_count += 1;
+
+        if (child.is_inflated()) {
+            tree_stats_helper(*(child.get()), depth+1,
+                              nodes, non_leaf_nodes, depth_sum,
+                              max_depth, children_count);
+        } else {
+            // Unvisited edge, counts as a leaf.
+            nodes += 1;
+            depth_sum += depth+1;
+            if (depth+1 > max_depth) max_depth = depth+1;
+        }
     }
 }
 
@@ -398,7 +430,7 @@ std::string UCTSearch::get_pv(FastState & state, UCTNode& parent) {
     }
 
     auto& best_child = parent.get_best_root_child(state.get_to_move());
-    if (best_child.first_visit()) {
+    if (best_child.get_visits() == 0) {
         return std::string();
     }
     auto best_move = best_child.get_move();
@@ -406,7 +438,7 @@ std::string UCTSearch::get_pv(FastState & state, UCTNode& parent) {
 
     state.play_move(best_move);
 
-    auto next = get_pv(state, best_child);
+    auto next = get_pv(state, *best_child.get());
     if (!next.empty()) {
         res.append(" ").append(next);
     }
@@ -427,8 +459,134 @@ void UCTSearch::dump_analysis(int playouts) {
              playouts, winrate, pvstring.c_str());
 }
 
+void UCTSearch::output_analysis(FastState & state, UCTNode & parent) {
+    // Only atomics are read here and nothing is sorted or inflated, so
+    // the search threads keep running while the snapshot is taken.
+    // Pruning happens on this thread, so no subtree goes away under us.
+    struct ChildStats {
+        UCTNode* node;
+        int move;
+        int visits;
+        float winrate;
+        float prior;
+    };
+
+    if (!parent.has_children()) {
+        return;
+    }
+    const auto color = state.get_to_move();
+
+    auto children = std::vector<ChildStats>{};
+    for (const auto& child : parent.get_children()) {
+        const auto visits = child.get_visits();
+        // A visited child is always inflated, so get() does not
+        // change the tree.
+        if (visits > 0 && child.valid()) {
+            children.push_back({child.get(), child.get_move(), visits,
+                                child.get_eval(color), child.get_score()});
+        }
+    }
+    if (children.empty()) {
+        return;
+    }
+    std::stable_sort(begin(children), end(children),
+        [](const ChildStats& a, const ChildStats& b) {
+            return std::tie(a.visits, a.winrate) > std::tie(b.visits, b.winrate);
+        });
+
+    auto line = std::string{};
+    auto order = 0;
+    for (const auto& child : children) {
+        auto tmpstate = state;
+        auto move = state.move_to_text(child.move);
+        tmpstate.play_move(child.move);
+        auto pv = get_pv(tmpstate, *child.node);
+
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer),
+                      "info move %s visits %d winrate %d prior %d order %d pv %s",
+                      move.c_str(), child.visits,
+                      static_cast<int>(child.winrate * 10000.0f),
+                      static_cast<int>(child.prior * 10000.0f),
+                      order++, move.c_str());
+        if (!line.empty()) {
+            line += " ";
+        }
+        line += buffer;
+        if (!pv.empty()) {
+            line += " " + pv;
+        }
+    }
+    GTP::analysis_output(line);
+}
+
 bool UCTSearch::is_running() const {
-    return m_run && m_nodes < MAX_TREE_SIZE;
+    return m_run && !m_pause;
+}
+
+std::size_t UCTSearch::get_tree_memory() {
+    auto bytes = UCTNodePool::get_used_bytes() + UCTNode::get_children_memory();
+    if (cfg_transpositions) {
+        bytes += TTable::get_TT().get_children_memory();
+    }
+    return bytes;
+}
+
+bool UCTSearch::tree_memory_full() const {
+    return get_tree_memory() >= cfg_max_tree_memory;
+}
+
+bool UCTSearch::prune_tree(ThreadGroup& tg) {
+    // The other search threads must be out of the tree before any
+    // subtree can be freed.
+    m_pause = true;
+    tg.wait_all();
+
+    // Freeing the previous tree may be all that is needed.
+    tree_reclaimer.wait_idle();
+
+    // The shared expansions are only a cache, they go before any node.
+    if (tree_memory_full() && cfg_transpositions) {
+        TTable::get_TT().drop_children();
+    }
+
+    if (tree_memory_full()) {
+        // Drop subtrees below ever larger visit counts until the tree is
+        // back under 3/4 of the budget, so we don't have to prune again
+        // soon.
+        const auto before = get_tree_memory();
+        const auto target = cfg_max_tree_memory / 4 * 3;
+        auto min_visits = 1;
+        while (get_tree_memory() > target
+               && min_visits <= m_root->get_visits()) {
+            min_visits *= 2;
+            m_root->prune_subtrees(min_visits);
+        }
+        m_nodes = m_root->count_nodes();
+
+        myprintf("Tree memory limit reached, pruned subtrees below %d "
+                 "visits: %.1f MiB -> %.1f MiB\n", min_visits,
+                 before / 1048576.0, get_tree_memory() / 1048576.0);
+    }
+
+    m_pause = false;
+    for (int i = 1; i < cfg_num_threads; i++) {
+        tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
+    }
+    return !tree_memory_full();
+}
+
+void UCTSearch::dump_tree_memory() {
+    myprintf("Tree memory: %.1f MiB nodes, %.1f MiB children, "
+             "%.1f MiB transpositions, %.1f MiB arena, budget %.1f MiB\n",
+             UCTNodePool::get_used_bytes() / 1048576.0,
+             UCTNode::get_children_memory() / 1048576.0,
+             cfg_transpositions
+                 ? TTable::get_TT().get_children_memory() / 1048576.0 : 0.0,
+             UCTNodePool::get_reserved_bytes() / 1048576.0,
+             cfg_max_tree_memory / 1048576.0);
+    myprintf("Tree GC backlog: %d trees\n",
+             static_cast<int>(tree_reclaimer.get_backlog()));
 }
 
 void UCTSearch::stop_think() {
@@ -455,16 +613,16 @@ int UCTSearch::est_playouts_left(int elapsed_centis, int time_for_move) const
 size_t UCTSearch::prune_noncontenders(int elapsed_centis, int time_for_move) {
     auto Nfirst = 0;
     for (const auto& node : m_root->get_children()) {
-        if (node->valid()) {
-             Nfirst = std::max(Nfirst, node->get_visits());
+        if (node.valid()) {
+             Nfirst = std::max(Nfirst, node.get_visits());
         }
     }
     const auto min_required_visits = Nfirst - est_playouts_left(elapsed_centis, time_for_move);
     auto pruned_nodes = size_t{0};
     for (const auto& node : m_root->get_children()) {
-        if (node->valid()) {
-             const auto has_enough_visits = node->get_visits() >= min_required_visits;
-             node->set_active(has_enough_visits);
+        if (node.valid()) {
+             const auto has_enough_visits = node.get_visits() >= min_required_visits;
+             node.get()->set_active(has_enough_visits);
              if (!has_enough_visits) {
                  ++pruned_nodes;
              }
@@ -483,8 +641,8 @@ bool UCTSearch::stop_thinking(int elapsed_centis, int time_for_move) const {
 
 void UCTWorker::operator()() {
     do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
-        auto result = m_search->play_simulation(*currstate, m_root);
+        auto currstate = SearchState(m_rootstate);
+        auto result = m_search->play_simulation(currstate, m_root);
         if (result.valid()) {
             m_search->increment_playouts();
         }
@@ -515,12 +673,16 @@ int UCTSearch::think(int color, passflag_t passflag) {
     // play something legal and decent even in time trouble)
     float root_eval;
     if (!m_root->has_children()) {
-        m_root->create_children(m_nodes, m_rootstate, root_eval);
+        auto rootstate = SearchState(m_rootstate);
+        m_root->create_children(m_nodes, rootstate, root_eval);
         m_root->update(root_eval);
     } else {
         root_eval = m_root->get_eval(color);
     }
     m_root->kill_superkos(m_rootstate);
+    m_nodes = m_root->count_nodes();
+    // Root children are pruned and reported individually.
+    m_root->inflate_all_children();
 
     myprintf("NN eval=%f\n",
              (color == FastBoard::BLACK ? root_eval : 1.0f - root_eval));
@@ -534,13 +696,18 @@ int UCTSearch::think(int color, passflag_t passflag) {
 
     bool keeprunning = true;
     int last_update = 0;
+    int last_output = 0;
     do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
+        auto currstate = SearchState(m_rootstate);
 
-        auto result = play_simulation(*currstate, m_root.get());
+        auto result = play_simulation(currstate, m_root.get());
         if (result.valid()) {
             increment_playouts();
         }
+        if (tree_memory_full() && !prune_tree(tg)) {
+            myprintf("Tree memory budget too small, stopping search.\n");
+            break;
+        }
 
         Time elapsed;
         int elapsed_centis = Time::timediff_centis(start, elapsed);
@@ -551,6 +718,11 @@ int UCTSearch::think(int color, passflag_t passflag) {
             last_update = elapsed_centis;
             dump_analysis(static_cast<int>(m_playouts));
         }
+        if (cfg_analyze_interval_centis
+            && elapsed_centis - last_output >= cfg_analyze_interval_centis) {
+            last_output = elapsed_centis;
+            output_analysis(m_rootstate, *m_root);
+        }
         keeprunning  = is_running();
         keeprunning &= !stop_thinking(elapsed_centis, time_for_move);
         if (keeprunning && cfg_timemanage == TimeManagement::ON) {
@@ -564,7 +736,7 @@ int UCTSearch::think(int color, passflag_t passflag) {
 
     // reactivate all pruned root children
     for (const auto& node : m_root->get_children()) {
-        node->set_active(true);
+        node.get()->set_active(true);
     }
 
     // stop the search
@@ -578,6 +750,9 @@ int UCTSearch::think(int color, passflag_t passflag) {
     // display search info
     myprintf("\n");
 
+    if (cfg_analyze_interval_centis) {
+        output_analysis(m_rootstate, *m_root);
+    }
     dump_stats(m_rootstate, *m_root);
 
     Time elapsed;
@@ -589,6 +764,12 @@ int UCTSearch::think(int color, passflag_t passflag) {
                  static_cast<int>(m_playouts),
                  (m_playouts * 100.0) / (elapsed_centis+1));
     }
+    batch_scheduler.dump_stats();
+    NNCache::get_NNCache().dump_stats();
+    if (cfg_transpositions) {
+        TTable::get_TT().dump_stats();
+    }
+    dump_tree_memory();
     int bestmove = get_best_move(passflag);
 
     // Copy the root state. Use to check for tree re-use in future calls.
@@ -599,6 +780,9 @@ int UCTSearch::think(int color, passflag_t passflag) {
 void UCTSearch::ponder() {
     update_root();
 
+    Time start;
+    int last_output = 0;
+
     m_run = true;
     int cpus = cfg_num_threads;
     ThreadGroup tg(thread_pool);
@@ -607,11 +791,23 @@ void UCTSearch::ponder() {
     }
     auto keeprunning = true;
     do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
-        auto result = play_simulation(*currstate, m_root.get());
+        auto currstate = SearchState(m_rootstate);
+        auto result = play_simulation(currstate, m_root.get());
         if (result.valid()) {
             increment_playouts();
         }
+        if (tree_memory_full() && !prune_tree(tg)) {
+            myprintf("Tree memory budget too small, stopping search.\n");
+            break;
+        }
+        if (cfg_analyze_interval_centis) {
+            Time elapsed;
+            int elapsed_centis = Time::timediff_centis(start, elapsed);
+            if (elapsed_centis - last_output >= cfg_analyze_interval_centis) {
+                last_output = elapsed_centis;
+                output_analysis(m_rootstate, *m_root);
+            }
+        }
         keeprunning  = is_running();
         keeprunning &= !stop_thinking(0, 1);
     } while(!Utils::input_pending() && keeprunning);
@@ -626,6 +822,65 @@ void UCTSearch::ponder() {
     myprintf("\n%d visits, %d nodes\n\n", m_root->get_visits(), m_nodes.load());
 }
 
+std::string UCTSearch::thread_scaling_benchmark(int playouts,
+                                                int max_threads) {
+    const auto saved_threads = cfg_num_threads;
+    auto table = std::string{"threads playouts/s speedup"};
+    auto base_rate = 0.0;
+
+    set_playout_limit(playouts);
+    for (auto threads = 1; threads <= max_threads; threads *= 2) {
+        // Every run starts from an empty tree and an empty cache.
+        tree_reclaimer.discard(std::move(m_root));
+        tree_reclaimer.wait_idle();
+        m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+        m_last_rootstate.reset(nullptr);
+        m_nodes = 0;
+        m_playouts = 0;
+        NNCache::get_NNCache().clear();
+
+        // Search threads never give their pool thread back while the
+        // search runs, so the pool needs one per extra thread.
+        while (thread_pool.size() < static_cast<size_t>(threads - 1)) {
+            thread_pool.add_thread([]() {});
+        }
+        cfg_num_threads = threads;
+
+        Time start;
+        m_run = true;
+        ThreadGroup tg(thread_pool);
+        for (int i = 1; i < threads; i++) {
+            tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
+        }
+        do {
+            auto currstate = SearchState(m_rootstate);
+            auto result = play_simulation(currstate, m_root.get());
+            if (result.valid()) {
+                increment_playouts();
+            }
+        } while (is_running() && !stop_thinking(0, 1));
+        m_run = false;
+        tg.wait_all();
+        Time end;
+
+        auto elapsed = std::max(Time::timediff_seconds(start, end), 0.001);
+        auto rate = m_playouts / elapsed;
+        if (threads == 1) {
+            base_rate = rate;
+        }
+        char line[64];
+        snprintf(line, sizeof(line), "%7d %11.1f %7.2f",
+                 threads, rate, rate / base_rate);
+        myprintf("%s\n", line);
+        table += "\n";
+        table += line;
+    }
+
+    cfg_num_threads = saved_threads;
+    set_playout_limit(cfg_max_playouts);
+    return table;
+}
+
 void UCTSearch::set_playout_limit(int playouts) {
     static_assert(std::is_convertible<decltype(playouts),
                                       decltype(m_maxplayouts)>::value,
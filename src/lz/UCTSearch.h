@@ -20,6 +20,8 @@
 #define UCTSEARCH_H_INCLUDED
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -27,6 +29,8 @@
 #include "FastBoard.h"
 #include "FastState.h"
 #include "GameState.h"
+#include "SearchState.h"
+#include "ThreadPool.h"
 #include "UCTNode.h"
 
 
@@ -35,8 +39,12 @@ public:
     SearchResult() = default;
     bool valid() const { return m_valid;  }
     float eval() const { return m_eval;  }
-    static SearchResult from_eval(float eval) {
-        return SearchResult(eval);
+    // Nodes added to the tree by this simulation.
+    int new_nodes() const { return m_new_nodes; }
+    static SearchResult from_eval(float eval, int new_nodes = 0) {
+        auto result = SearchResult(eval);
+        result.m_new_nodes = new_nodes;
+        return result;
     }
     static SearchResult from_score(float board_score) {
         if (board_score > 0.0f) {
@@ -52,6 +60,7 @@ private:
         : m_valid(true), m_eval(eval) {}
     bool m_valid{false};
     float m_eval{0.0f};
+    int m_new_nodes{0};
 };
 
 namespace TimeManagement {
@@ -73,12 +82,14 @@ public:
     static constexpr passflag_t NORESIGN = 1 << 1;
 
     /*
-        Maximum size of the tree in memory. Nodes are about
-        48 bytes, so limit to ~1.2G on 32-bits and about 5.5G
-        on 64-bits.
+        Default memory budget for the search tree, in bytes. This covers
+        the node slots and the child lists. When it is reached the search
+        prunes low-visit subtrees and carries on. Limit to 1G on 32-bits
+        and 4G on 64-bits.
     */
-    static constexpr auto MAX_TREE_SIZE =
-        (sizeof(void*) == 4 ? 25'000'000 : 100'000'000);
+    static constexpr std::uint64_t DEFAULT_MAX_TREE_MEMORY =
+        (sizeof(void*) == 4 ? std::uint64_t{1} << 30
+                            : std::uint64_t{4} << 30);
 
     UCTSearch(GameState& g);
     int think(int color, passflag_t passflag = NORMAL);
@@ -91,17 +102,25 @@ public:
     size_t prune_noncontenders(int elapsed_centis = 0, int time_for_move = 0);
     bool stop_thinking(int elapsed_centis = 0, int time_for_move = 0) const;
     void increment_playouts();
-    SearchResult play_simulation(GameState& currstate, UCTNode* const node);
+    static std::size_t get_tree_memory();
+    std::string thread_scaling_benchmark(int playouts, int max_threads);
+    SearchResult play_simulation(SearchState& currstate, UCTNode* const node);
 
 private:
     void dump_stats(FastState& state, UCTNode& parent);
     void tree_stats(const UCTNode& node);
     std::string get_pv(FastState& state, UCTNode& parent);
     void dump_analysis(int playouts);
+    // One "info move ..." line with the stats of the visited children,
+    // see the lz-analyze GTP command.
+    void output_analysis(FastState& state, UCTNode& parent);
     bool should_resign(passflag_t passflag, float bestscore);
     int get_best_move(passflag_t passflag);
     void update_root();
     bool advance_to_new_rootstate();
+    bool tree_memory_full() const;
+    bool prune_tree(Utils::ThreadGroup& tg);
+    void dump_tree_memory();
 
     GameState & m_rootstate;
     std::unique_ptr<GameState> m_last_rootstate;
@@ -109,6 +128,7 @@ private:
     std::atomic<int> m_nodes{0};
     std::atomic<int> m_playouts{0};
     std::atomic<bool> m_run{false};
+    std::atomic<bool> m_pause{false};
     int m_maxplayouts;
     int m_maxvisits;
 };
@@ -0,0 +1,118 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Built with AVX2 enabled, see CMakeLists.txt. Only called when
+// WinogradKernels::get_isa() found AVX2 on the CPU.
+
+#include "config.h"
+#include "WinogradKernels.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+#include "WinogradSimd.h"
+
+namespace {
+
+struct Avx2Ops {
+    using vec = __m256;
+    using mask = __m256i;
+    static constexpr auto WIDTH = 8;
+
+    static mask make_mask(int first, int last) {
+        const auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        return _mm256_andnot_si256(
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(first), lanes),
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(last), lanes));
+    }
+    static vec load(const float* p) {
+        return _mm256_loadu_ps(p);
+    }
+    static vec load(const float* p, mask m) {
+        return _mm256_maskload_ps(p, m);
+    }
+    static void store(float* p, vec v) {
+        _mm256_storeu_ps(p, v);
+    }
+    static void store(float* p, vec v, mask m) {
+        _mm256_maskstore_ps(p, m, v);
+    }
+    static vec add(vec a, vec b) {
+        return _mm256_add_ps(a, b);
+    }
+    static vec sub(vec a, vec b) {
+        return _mm256_sub_ps(a, b);
+    }
+    static vec mul(vec a, vec b) {
+        return _mm256_mul_ps(a, b);
+    }
+    static vec max(vec a, vec b) {
+        return _mm256_max_ps(a, b);
+    }
+    static vec set1(float x) {
+        return _mm256_set1_ps(x);
+    }
+    static vec zero() {
+        return _mm256_setzero_ps();
+    }
+    static void interleave(vec a, vec b, vec& lo, vec& hi) {
+        // unpack works within each 128-bit half
+        auto l = _mm256_unpacklo_ps(a, b);
+        auto h = _mm256_unpackhi_ps(a, b);
+        lo = _mm256_permute2f128_ps(l, h, 0x20);
+        hi = _mm256_permute2f128_ps(l, h, 0x31);
+    }
+    static void split(const float* p, float* even, float* odd) {
+        const auto idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        auto v = _mm256_permutevar8x32_ps(_mm256_loadu_ps(p), idx);
+        _mm_storeu_ps(even, _mm256_castps256_ps128(v));
+        _mm_storeu_ps(odd, _mm256_extractf128_ps(v, 1));
+    }
+};
+
+}
+
+bool WinogradKernels::transform_in_avx2(const float* in, float* V,
+                                        int C, int batch_size) {
+    transform_in<Avx2Ops>(in, V, C, batch_size);
+    return true;
+}
+
+bool WinogradKernels::transform_out_avx2(const float* M, float* Y,
+                                         int K, int batch_size,
+                                         const float* bn_means,
+                                         const float* bn_stddivs,
+                                         const float* residual) {
+    transform_out<Avx2Ops>(M, Y, K, batch_size,
+                           bn_means, bn_stddivs, residual);
+    return true;
+}
+
+#else
+
+bool WinogradKernels::transform_in_avx2(const float*, float*, int, int) {
+    return false;
+}
+
+bool WinogradKernels::transform_out_avx2(const float*, float*, int, int,
+                                         const float*, const float*,
+                                         const float*) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Built with AVX-512 enabled, see CMakeLists.txt. Only called when
+// WinogradKernels::get_isa() found AVX-512F on the CPU.
+
+#include "config.h"
+#include "WinogradKernels.h"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+
+#include "WinogradSimd.h"
+
+namespace {
+
+struct Avx512Ops {
+    using vec = __m512;
+    using mask = __mmask16;
+    static constexpr auto WIDTH = 16;
+
+    static mask make_mask(int first, int last) {
+        return static_cast<mask>(((1u << last) - 1) & ~((1u << first) - 1));
+    }
+    static vec load(const float* p) {
+        return _mm512_loadu_ps(p);
+    }
+    static vec load(const float* p, mask m) {
+        return _mm512_maskz_loadu_ps(m, p);
+    }
+    static void store(float* p, vec v) {
+        _mm512_storeu_ps(p, v);
+    }
+    static void store(float* p, vec v, mask m) {
+        _mm512_mask_storeu_ps(p, m, v);
+    }
+    static vec add(vec a, vec b) {
+        return _mm512_add_ps(a, b);
+    }
+    static vec sub(vec a, vec b) {
+        return _mm512_sub_ps(a, b);
+    }
+    static vec mul(vec a, vec b) {
+        return _mm512_mul_ps(a, b);
+    }
+    // The zero masking forms of max, permutexvar and extractf64x4 are
+    // used with all lanes set. The plain ones pass _mm512_undefined_ps
+    // to the builtin, which GCC reports as -Wmaybe-uninitialized.
+    static vec max(vec a, vec b) {
+        return _mm512_maskz_max_ps(0xffff, a, b);
+    }
+    static vec set1(float x) {
+        return _mm512_set1_ps(x);
+    }
+    static vec zero() {
+        return _mm512_setzero_ps();
+    }
+    static void interleave(vec a, vec b, vec& lo, vec& hi) {
+        // indices 16 and up select from b
+        const auto idx_lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19,
+                                              4, 20, 5, 21, 6, 22, 7, 23);
+        const auto idx_hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27,
+                                              12, 28, 13, 29, 14, 30, 15, 31);
+        lo = _mm512_permutex2var_ps(a, idx_lo, b);
+        hi = _mm512_permutex2var_ps(a, idx_hi, b);
+    }
+    static void split(const float* p, float* even, float* odd) {
+        const auto idx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+                                           1, 3, 5, 7, 9, 11, 13, 15);
+        auto v = _mm512_castps_pd(
+            _mm512_maskz_permutexvar_ps(0xffff, idx, _mm512_loadu_ps(p)));
+        auto lower = _mm512_maskz_extractf64x4_pd(0xff, v, 0);
+        auto upper = _mm512_maskz_extractf64x4_pd(0xff, v, 1);
+        _mm256_storeu_ps(even, _mm256_castpd_ps(lower));
+        _mm256_storeu_ps(odd, _mm256_castpd_ps(upper));
+    }
+};
+
+}
+
+bool WinogradKernels::transform_in_avx512(const float* in, float* V,
+                                          int C, int batch_size) {
+    transform_in<Avx512Ops>(in, V, C, batch_size);
+    return true;
+}
+
+bool WinogradKernels::transform_out_avx512(const float* M, float* Y,
+                                           int K, int batch_size,
+                                           const float* bn_means,
+                                           const float* bn_stddivs,
+                                           const float* residual) {
+    transform_out<Avx512Ops>(M, Y, K, batch_size,
+                             bn_means, bn_stddivs, residual);
+    return true;
+}
+
+#else
+
+bool WinogradKernels::transform_in_avx512(const float*, float*, int, int) {
+    return false;
+}
+
+bool WinogradKernels::transform_out_avx512(const float*, float*, int, int,
+                                           const float*, const float*,
+                                           const float*) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include "WinogradKernels.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+using namespace WinogradKernels;
+
+static Isa detect_isa() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Isa::AVX2;
+    }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return Isa::SCALAR;
+    }
+    __cpuid(regs, 1);
+    const auto osxsave = (regs[2] & (1 << 27)) != 0;
+    const auto fma = (regs[2] & (1 << 12)) != 0;
+    if (!osxsave) {
+        return Isa::SCALAR;
+    }
+    // The OS must save the vector registers on context switches.
+    const auto xcr0 = _xgetbv(0);
+    __cpuidex(regs, 7, 0);
+    const auto avx2 = (regs[1] & (1 << 5)) != 0;
+    const auto avx512f = (regs[1] & (1 << 16)) != 0;
+    if (avx512f && (xcr0 & 0xE6) == 0xE6) {
+        return Isa::AVX512;
+    }
+    if (avx2 && fma && (xcr0 & 0x6) == 0x6) {
+        return Isa::AVX2;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+Isa WinogradKernels::get_isa() {
+    static const auto isa = detect_isa();
+    return isa;
+}
+
+const char* WinogradKernels::get_isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::AVX512:
+        return "AVX-512";
+    case Isa::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
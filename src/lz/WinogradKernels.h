@@ -0,0 +1,60 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WINOGRADKERNELS_H_INCLUDED
+#define WINOGRADKERNELS_H_INCLUDED
+
+#include "config.h"
+
+/*
+    SIMD versions of the Winograd input and output transforms used by
+    Network::forward_cpu. They take the same buffer layouts as the scalar
+    Network::winograd_transform_in/out and give the same results up to
+    float rounding. Each instruction set lives in its own translation unit
+    built with the matching compiler flags, and is only called after
+    get_isa() has checked that the CPU supports it.
+*/
+namespace WinogradKernels {
+    enum class Isa {
+        SCALAR, AVX2, AVX512
+    };
+
+    // Best instruction set available on this CPU, detected once.
+    Isa get_isa();
+    const char* get_isa_name(Isa isa);
+
+    // Vectorized over the tiles of one board row. They return false,
+    // without touching the output, when the instruction set was not
+    // compiled in (non-x86 builds).
+    bool transform_in_avx2(const float* in, float* V,
+                           int C, int batch_size);
+    // Output transforms fused with batchnorm, residual add and ReLU,
+    // as Network::winograd_transform_out.
+    bool transform_out_avx2(const float* M, float* Y,
+                            int K, int batch_size,
+                            const float* bn_means, const float* bn_stddivs,
+                            const float* residual);
+    bool transform_in_avx512(const float* in, float* V,
+                             int C, int batch_size);
+    bool transform_out_avx512(const float* M, float* Y,
+                              int K, int batch_size,
+                              const float* bn_means, const float* bn_stddivs,
+                              const float* residual);
+}
+
+#endif
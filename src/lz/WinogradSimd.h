@@ -0,0 +1,285 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2018 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WINOGRADSIMD_H_INCLUDED
+#define WINOGRADSIMD_H_INCLUDED
+
+#include "config.h"
+
+#include <cassert>
+
+/*
+    Transform kernels shared by the per instruction set translation units
+    (WinogradAvx2.cpp, WinogradAvx512.cpp). Each of them includes this file
+    with its own Ops, which wraps the intrinsics:
+
+        vec, mask, WIDTH
+        make_mask(a, b)     lanes [a, b) enabled
+        load(p), load(p, m), store(p, v), store(p, v, m)
+        set1(x), zero(), add(a, b), sub(a, b), mul(a, b), max(a, b)
+        interleave(a, b, lo, hi)
+                            lo = a0 b0 a1 b1 ..., hi = the upper half
+        split(p, even, odd) WIDTH floats from p, the even ones to
+                            even[0, WIDTH / 2), the odd ones to odd
+
+    Everything is in an anonymous namespace and uses no standard library
+    templates: this code is compiled with instruction set flags the rest
+    of the program can't assume, so none of it may be shared with other
+    translation units by the linker.
+*/
+namespace {
+
+constexpr auto W = BOARD_SIZE;
+constexpr auto H = BOARD_SIZE;
+constexpr auto WTILES = (W + 1) / 2;
+constexpr auto P = WTILES * WTILES;
+constexpr auto ALPHA = 4;
+
+// Zero padded copy of one input plane, with the even and odd columns
+// split so that the first column of each tile in a row are consecutive.
+constexpr auto PAD_ROWS = 2 * WTILES + 2;
+constexpr auto PAD_COLS = 32;
+static_assert(WTILES + 1 <= PAD_COLS / 2, "Board too large for padding");
+
+// The tiles of a board row covered by one vector. When the row is not
+// a multiple of the width, the last vector is moved back to overlap the
+// previous one if it fits in the row, and masked otherwise.
+template <typename Ops>
+struct Chunk {
+    int bx0;
+    bool full;
+    typename Ops::mask tiles;
+    // Output columns [2 * bx0, 2 * bx0 + 2 * WIDTH) to store: on the
+    // board and not already written by the previous chunk, as the
+    // residual can be read from the output buffer itself.
+    typename Ops::mask lo;
+    typename Ops::mask hi;
+    bool has_hi;
+};
+
+template <typename Ops>
+typename Ops::mask make_lane_mask(int first, int last) {
+    first = first < 0 ? 0 : first;
+    last = last > Ops::WIDTH ? Ops::WIDTH : last;
+    return Ops::make_mask(first, last < first ? first : last);
+}
+
+template <typename Ops>
+int make_chunks(Chunk<Ops>* chunks) {
+    auto count = 0;
+    // Output columns stored by the chunks so far.
+    auto stored = 0;
+    for (auto bx0 = 0; bx0 < WTILES; bx0 += Ops::WIDTH) {
+        auto& c = chunks[count++];
+        c.bx0 = bx0;
+        auto tiles = WTILES - bx0;
+        if (tiles < Ops::WIDTH && WTILES >= Ops::WIDTH) {
+            c.bx0 = WTILES - Ops::WIDTH;
+            tiles = Ops::WIDTH;
+        }
+        if (tiles > Ops::WIDTH) {
+            tiles = Ops::WIDTH;
+        }
+        c.full = tiles == Ops::WIDTH;
+        c.tiles = Ops::make_mask(0, tiles);
+
+        // Columns relative to the first lane of lo.
+        const auto first = 2 * (bx0 - c.bx0);
+        const auto last = W - 2 * c.bx0;
+        c.lo = make_lane_mask<Ops>(first, last);
+        c.hi = make_lane_mask<Ops>(first - Ops::WIDTH, last - Ops::WIDTH);
+        c.has_hi = last > Ops::WIDTH;
+
+        // Each column is stored by exactly one chunk, see store_bn.
+        assert(first >= 0 && 2 * c.bx0 + first == stored);
+        stored = last < 2 * Ops::WIDTH ? W : 2 * c.bx0 + 2 * Ops::WIDTH;
+    }
+    assert(stored == W);
+    return count;
+}
+
+template <typename Ops>
+void transform_in(const float* in, float* V, const int C, const int batch_size) {
+    using vec = typename Ops::vec;
+    const auto batch_P = batch_size * P;
+    const auto plane = C * batch_P;
+
+    Chunk<Ops> chunks[WTILES];
+    const auto num_chunks = make_chunks<Ops>(chunks);
+
+    // The border stays zero, only the board area is rewritten per plane.
+    alignas(64) float pad[PAD_ROWS][2][PAD_COLS];
+    for (auto r = 0; r < PAD_ROWS; r++) {
+        for (auto c = 0; c < PAD_COLS; c++) {
+            pad[r][0][c] = 0.0f;
+            pad[r][1][c] = 0.0f;
+        }
+    }
+
+    for (auto n = 0; n < batch_size; n++) {
+        for (auto ch = 0; ch < C; ch++) {
+            const auto src = in + (n * C + ch) * (W * H);
+            for (auto y = 0; y < H; y++) {
+                // Padded column x + 1: even x go to the odd half.
+                auto& p = pad[y + 1];
+                auto x = 0;
+                for (; x + Ops::WIDTH <= W; x += Ops::WIDTH) {
+                    Ops::split(&src[y * W + x], &p[1][x / 2], &p[0][x / 2 + 1]);
+                }
+                for (; x < W; x++) {
+                    p[(x + 1) & 1][(x + 1) >> 1] = src[y * W + x];
+                }
+            }
+
+            for (auto block_y = 0; block_y < WTILES; block_y++) {
+                for (auto i = 0; i < num_chunks; i++) {
+                    const auto& chunk = chunks[i];
+                    const auto bx0 = chunk.bx0;
+
+                    vec x[ALPHA][ALPHA];
+                    for (auto row = 0; row < ALPHA; row++) {
+                        const auto& p = pad[2 * block_y + row];
+                        x[row][0] = Ops::load(&p[0][bx0]);
+                        x[row][1] = Ops::load(&p[1][bx0]);
+                        x[row][2] = Ops::load(&p[0][bx0 + 1]);
+                        x[row][3] = Ops::load(&p[1][bx0 + 1]);
+                    }
+
+                    // transpose(B).x.B, see Network::winograd_transform_in
+                    vec T1[ALPHA][ALPHA];
+                    for (auto j = 0; j < ALPHA; j++) {
+                        T1[0][j] = Ops::sub(x[0][j], x[2][j]);
+                        T1[1][j] = Ops::add(x[1][j], x[2][j]);
+                        T1[2][j] = Ops::sub(x[2][j], x[1][j]);
+                        T1[3][j] = Ops::sub(x[1][j], x[3][j]);
+                    }
+
+                    const auto offset = ch * batch_P + n * P
+                                        + block_y * WTILES + bx0;
+                    for (auto row = 0; row < ALPHA; row++) {
+                        vec T2[ALPHA];
+                        T2[0] = Ops::sub(T1[row][0], T1[row][2]);
+                        T2[1] = Ops::add(T1[row][1], T1[row][2]);
+                        T2[2] = Ops::sub(T1[row][2], T1[row][1]);
+                        T2[3] = Ops::sub(T1[row][1], T1[row][3]);
+                        for (auto j = 0; j < ALPHA; j++) {
+                            auto dst = V + (row * ALPHA + j) * plane + offset;
+                            if (chunk.full) {
+                                Ops::store(dst, T2[j]);
+                            } else {
+                                Ops::store(dst, T2[j], chunk.tiles);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Batchnorm, optional residual add and ReLU, then a masked store.
+// The residual may be the output buffer itself. That only works because
+// m never includes columns another chunk stores (make_chunks asserts
+// this), so no column is stored before all the reads of it are done.
+template <typename Ops>
+void store_bn(float* dst, const float* res, typename Ops::mask m,
+              typename Ops::vec v, typename Ops::vec mean,
+              typename Ops::vec scale) {
+    v = Ops::mul(scale, Ops::sub(v, mean));
+    if (res) {
+        v = Ops::add(v, Ops::load(res, m));
+    }
+    Ops::store(dst, Ops::max(v, Ops::zero()), m);
+}
+
+template <typename Ops>
+void store_row(float* dst, const float* res, const Chunk<Ops>& chunk,
+               typename Ops::vec a, typename Ops::vec b,
+               typename Ops::vec mean, typename Ops::vec scale) {
+    typename Ops::vec lo, hi;
+    Ops::interleave(a, b, lo, hi);
+    store_bn<Ops>(dst, res, chunk.lo, lo, mean, scale);
+    if (chunk.has_hi) {
+        store_bn<Ops>(dst + Ops::WIDTH, res ? res + Ops::WIDTH : nullptr,
+                      chunk.hi, hi, mean, scale);
+    }
+}
+
+template <typename Ops>
+void transform_out(const float* M, float* Y, const int K, const int batch_size,
+                   const float* bn_means, const float* bn_stddivs,
+                   const float* residual) {
+    using vec = typename Ops::vec;
+    const auto batch_P = batch_size * P;
+    const auto plane = K * batch_P;
+
+    Chunk<Ops> chunks[WTILES];
+    const auto num_chunks = make_chunks<Ops>(chunks);
+
+    for (auto n = 0; n < batch_size; n++) {
+        for (auto k = 0; k < K; k++) {
+            const auto out = Y + (n * K + k) * (H * W);
+            const auto res = residual ? residual + (n * K + k) * (H * W)
+                                      : nullptr;
+            const auto mean = Ops::set1(bn_means[k]);
+            const auto scale = Ops::set1(bn_stddivs[k]);
+            for (auto block_y = 0; block_y < WTILES; block_y++) {
+                const auto y = 2 * block_y;
+                for (auto i = 0; i < num_chunks; i++) {
+                    const auto& chunk = chunks[i];
+                    const auto bx0 = chunk.bx0;
+                    const auto b = n * P + block_y * WTILES + bx0;
+
+                    vec m[ALPHA * ALPHA];
+                    for (auto e = 0; e < ALPHA * ALPHA; e++) {
+                        const auto src = M + e * plane + k * batch_P + b;
+                        // Masked so the last tiles don't read past M.
+                        m[e] = chunk.full ? Ops::load(src)
+                                          : Ops::load(src, chunk.tiles);
+                    }
+
+                    // transpose(A).m.A, see Network::winograd_transform_out
+                    vec r0[ALPHA], r1[ALPHA];
+                    for (auto j = 0; j < ALPHA; j++) {
+                        auto s12 = Ops::add(m[1 * ALPHA + j], m[2 * ALPHA + j]);
+                        auto d12 = Ops::sub(m[1 * ALPHA + j], m[2 * ALPHA + j]);
+                        r0[j] = Ops::add(m[0 * ALPHA + j], s12);
+                        r1[j] = Ops::sub(d12, m[3 * ALPHA + j]);
+                    }
+                    auto o11 = Ops::add(Ops::add(r0[0], r0[1]), r0[2]);
+                    auto o12 = Ops::sub(Ops::sub(r0[1], r0[2]), r0[3]);
+                    auto o21 = Ops::add(Ops::add(r1[0], r1[1]), r1[2]);
+                    auto o22 = Ops::sub(Ops::sub(r1[1], r1[2]), r1[3]);
+
+                    const auto row0 = y * W + 2 * bx0;
+                    const auto row1 = row0 + W;
+                    store_row<Ops>(out + row0, res ? res + row0 : nullptr,
+                                   chunk, o11, o12, mean, scale);
+                    if (y + 1 < H) {
+                        store_row<Ops>(out + row1, res ? res + row1 : nullptr,
+                                       chunk, o21, o22, mean, scale);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
+
+#endif
@@ -18,12 +18,14 @@
 
 #include "config.h"
 #include "Zobrist.h"
+#include "Network.h"
 #include "Random.h"
 
 std::array<std::array<std::uint64_t, FastBoard::MAXSQ>,     4> Zobrist::zobrist;
 std::array<std::uint64_t, FastBoard::MAXSQ>                    Zobrist::zobrist_ko;
 std::array<std::array<std::uint64_t, FastBoard::MAXSQ * 2>, 2> Zobrist::zobrist_pris;
 std::array<std::uint64_t, 5>                                   Zobrist::zobrist_pass;
+std::array<std::array<std::array<std::uint64_t, FastBoard::MAXSQ>, 2>, 8> Zobrist::zobrist_symmetry;
 
 void Zobrist::init_zobrist(Random& rng) {
     for (int i = 0; i < 4; i++) {
@@ -45,4 +47,22 @@ void Zobrist::init_zobrist(Random& rng) {
     for (int i = 0; i < 5; i++) {
         Zobrist::zobrist_pass[i]  = rng.randuint64();
     }
+
+    // Vertices off the board never hold stones, they keep their own keys.
+    constexpr auto squaresize = BOARD_SIZE + 2;
+    for (int s = 0; s < 8; s++) {
+        for (int c = 0; c < 2; c++) {
+            Zobrist::zobrist_symmetry[s][c] = Zobrist::zobrist[c];
+            for (int y = 0; y < BOARD_SIZE; y++) {
+                for (int x = 0; x < BOARD_SIZE; x++) {
+                    auto idx = Network::rotate_nn_idx(y * BOARD_SIZE + x, s);
+                    auto vertex = (y + 1) * squaresize + (x + 1);
+                    auto image = (idx / BOARD_SIZE + 1) * squaresize
+                                 + (idx % BOARD_SIZE + 1);
+                    Zobrist::zobrist_symmetry[s][c][vertex] =
+                        Zobrist::zobrist[c][image];
+                }
+            }
+        }
+    }
 }
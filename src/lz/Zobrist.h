@@ -35,6 +35,9 @@ public:
     static std::array<std::uint64_t, FastBoard::MAXSQ>                    zobrist_ko;
     static std::array<std::array<std::uint64_t, FastBoard::MAXSQ * 2>, 2> zobrist_pris;
     static std::array<std::uint64_t, 5>                                   zobrist_pass;
+    // zobrist[color] of the vertex each vertex maps to under the 8 board
+    // symmetries, numbered as Network::rotate_nn_idx. For the stones only.
+    static std::array<std::array<std::array<std::uint64_t, FastBoard::MAXSQ>, 2>, 8> zobrist_symmetry;
 
     static void init_zobrist(Random& rng);
 };
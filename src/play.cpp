@@ -71,6 +71,10 @@ int main(int argc, char **argv) {
             cout << "--weights <weights file> | -w <weights file>" << endl;
             cout << "  if not specified, auto search in local directory" << endl;
             cout << endl;
+            cout << "--transpositions" << endl;
+            cout << "  share network evals between transpositions, the table holds up to" << endl;
+            cout << "  100000 expansions of about 3 KB each (~300 MB), counted in --treememory" << endl;
+            cout << endl;
             cout << "example:" << endl;
             cout << "./leelazui --player ./AQ -w ./best_v.txt, AQ(B) vs built-in engine with weights best_v1" << endl;
             cout << "./leelazui -w ./best_v.txt --player ./AQ, AQ(W) vs built-in engine with weights best_v1" << endl;
@@ -327,6 +331,14 @@ int advisor(const string& cmdline, const string& selfpath) {
         }
     };
 
+    agent.onThinkStats = [&](const std::vector<genmove_stats>& stats) {
+#ifndef NO_GUI_SUPPORT
+        // the candidates so far, best first, while the engine thinks
+        if (board_ui && !stats.empty())
+            board_ui->indicate(stats.front().move, stats);
+#endif
+    };
+
     if (cmdline.empty())
         agent.execute();
     else
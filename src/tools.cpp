@@ -1,5 +1,6 @@
 #include "tools.h"
 #include "lz/GTP.h"
+#include "lz/Network.h"
 
 #include <iostream>
 #ifdef _WIN32
@@ -74,73 +75,34 @@ static vector<string> listFiles(const string &directory)
 } // GetFilesInDirectory
 
 
-static 
-std::pair<int, int>  parse_v1_network(std::ifstream& wtfile) {
-
-    // First line was the version number
-    auto linecount = size_t{1};
-    auto channels = 0;
-    auto line = std::string{};
-    while (std::getline(wtfile, line)) {
-        auto iss = std::stringstream{line};
-        // Third line of parameters are the convolution layer biases,
-        // so this tells us the amount of channels in the residual layers.
-        // We are assuming all layers have the same amount of filters.
-        if (linecount == 2) {
-            auto count = std::distance(std::istream_iterator<std::string>(iss),
-                                       std::istream_iterator<std::string>());
-            channels = count;
-        }
-        linecount++;
-    }
-    // 1 format id, 1 input layer (4 x weights), 14 ending weights,
-    // the rest are residuals, every residual has 8 x weight lines
-    auto residual_blocks = linecount - (1 + 4 + 14);
-    if (residual_blocks % 8 != 0) {
-        return {0, 0};
-    }
-    residual_blocks /= 8;
-    wtfile.close();
-
-    return {channels, residual_blocks};
-}
-
 string findPossibleWeightsFile(const string &directory) {
 
     auto flist = listFiles(directory);
 
     size_t max_residual_blocks = 0;
     string select_file;
+    bool select_binary = false;
 
     for (auto fullpath : flist) {
         auto ext = fullpath.substr(fullpath.rfind(".")+1);
-        if (ext == "txt") {
-            auto format_version = -1;
-            size_t channels = 0, residual_blocks;
-
-            auto wtfile = std::ifstream{fullpath};
-            if (wtfile) {
-                auto line = std::string{};
-                if (std::getline(wtfile, line)) {
-                    if (line.size() < 4)
-                        format_version = stoi(line);
-
-                    if (format_version == 1) {
-                
-                        std::tie(channels, residual_blocks) = parse_v1_network(wtfile);
-                        if (channels != 0) {
-                            cerr << "Found weights: " << fullpath << endl;
-                            cerr << "channels: " << channels << endl;
-                            cerr << "residual_blocks: " << residual_blocks << endl;
-
-                            if (channels > max_residual_blocks) {
-                                max_residual_blocks = channels;
-                                select_file = fullpath;
-                            }
-                        }
-                    }
+        if (ext == "txt" || ext == "bin") {
+            // Only reads the header, text files don't tell their blocks.
+            int channels, residual_blocks;
+            std::tie(channels, residual_blocks) = Network::peek_weights_file(fullpath);
+            if (channels != 0) {
+                cerr << "Found weights: " << fullpath << endl;
+                cerr << "channels: " << channels << endl;
+                if (residual_blocks != 0)
+                    cerr << "residual_blocks: " << residual_blocks << endl;
+
+                // The same net in binary loads faster.
+                auto binary = residual_blocks != 0;
+                if (size_t(channels) > max_residual_blocks
+                    || (size_t(channels) == max_residual_blocks && binary && !select_binary)) {
+                    max_residual_blocks = channels;
+                    select_file = fullpath;
+                    select_binary = binary;
                 }
-                wtfile.close();
             }
         }
     }
@@ -166,6 +128,8 @@ void parseLeelaZeroArgs(int argc, char **argv, vector<string>& players) {
 
     selfpath = selfpath.substr(0, pos); 
 
+    int num_threads = 0;
+    string convert_to;
 
     for (int i=1; i<argc; i++) {
         string opt = argv[i];
@@ -183,7 +147,8 @@ void parseLeelaZeroArgs(int argc, char **argv, vector<string>& players) {
         }
         else if (opt == "--player") {
             string player = argv[++i];
-            if (player.find(" ") == string::npos && player.find(".txt") != string::npos) {
+            if (player.find(" ") == string::npos
+                && (player.find(".txt") != string::npos || player.find(".bin") != string::npos)) {
 #ifdef _WIN32
                 player = "leelaz.exe -g -w " + player;
 #else
@@ -193,13 +158,29 @@ void parseLeelaZeroArgs(int argc, char **argv, vector<string>& players) {
             players.push_back(player);
         }
         else if (opt == "--threads" || opt == "-t") {
-            int num_threads = std::stoi(argv[++i]);
-            if (num_threads > cfg_num_threads) {
-                fprintf(stderr, "Clamping threads to maximum = %d\n", cfg_num_threads);
-            } else if (num_threads != cfg_num_threads) {
-                fprintf(stderr, "Using %d thread(s).\n", num_threads);
-                cfg_num_threads = num_threads;
-            }
+            num_threads = std::stoi(argv[++i]);
+        }
+        else if (opt == "--batchsize") {
+            cfg_batch_size = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (opt == "--batchwait") {
+            cfg_batch_wait_us = std::stoi(argv[++i]);
+        }
+        else if (opt == "--treememory") {
+            cfg_max_tree_memory = std::uint64_t(std::stoi(argv[++i])) << 20;
+        }
+        else if (opt == "--transpositions") {
+            // Up to ~300 MB of shared expansions, within --treememory.
+            cfg_transpositions = true;
+        }
+        else if (opt == "--int8") {
+            cfg_int8 = true;
+        }
+        else if (opt == "--average-symmetries") {
+            cfg_average_symmetries = true;
+        }
+        else if (opt == "--convert-weights") {
+            convert_to = argv[++i];
         }
         else if (opt == "--playouts" || opt == "-p") {
             cfg_max_playouts = std::stoi(argv[++i]);
@@ -234,6 +215,9 @@ void parseLeelaZeroArgs(int argc, char **argv, vector<string>& players) {
             cfg_weightsfile = argv[++i];
             players.push_back("");
         }
+        else if (opt == "--nncache-file") {
+            cfg_nncache_file = argv[++i];
+        }
         else if (opt == "--logfile" || opt == "-l") {
                 cfg_logfile = argv[++i];
                 fprintf(stderr, "Logging to %s.\n", cfg_logfile.c_str());
@@ -271,6 +255,26 @@ void parseLeelaZeroArgs(int argc, char **argv, vector<string>& players) {
         }
     }
 
+    // Converts the -w text weights to the binary format, then exits.
+    if (convert_to.size()) {
+        auto ok = Network::convert_weights(cfg_weightsfile, convert_to);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    // Batched evaluation needs enough search threads blocked on the
+    // network to fill a batch on every core.
+    auto max_threads = cfg_num_threads * cfg_batch_size;
+    if (num_threads == 0 && cfg_batch_size > 1) {
+        num_threads = max_threads;
+    }
+    if (num_threads > max_threads) {
+        fprintf(stderr, "Clamping threads to maximum = %d\n", max_threads);
+        cfg_num_threads = max_threads;
+    } else if (num_threads > 0 && num_threads != cfg_num_threads) {
+        fprintf(stderr, "Using %d thread(s).\n", num_threads);
+        cfg_num_threads = num_threads;
+    }
+
     if (append_str.size())
         for (auto& line : players) {
             if (line.size())